@@ -0,0 +1,150 @@
+#include "safe_channel.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+
+using namespace std;
+
+// Keeps the consumers from being optimised away.
+volatile uint64_t sink;
+
+// Pushes in bursts, letting the consumer run in between.
+local_executor::task produce(local_executor& ex, safe_channel<uint64_t>& ch, size_t count, size_t burst)
+{
+	for (size_t i = 0; i < count; ++i) {
+		co_await ch.push(i);
+		if (i % burst == burst - 1) {
+			co_await ex.yield();
+		}
+	}
+	ch.close();
+}
+
+local_executor::task consume(safe_channel<uint64_t>& ch)
+{
+	uint64_t sum = 0;
+	while (auto v = co_await ch.pop()) {
+		sum += *v;
+	}
+	sink = sum;
+}
+
+local_executor::task consume_batches(safe_channel<uint64_t>& ch, size_t batch)
+{
+	uint64_t sum = 0;
+	for (;;) {
+		auto values = co_await ch.pop_many(batch);
+		if (values.empty()) {
+			break;
+		}
+		for (auto v : values) {
+			sum += v;
+		}
+	}
+	sink = sum;
+}
+
+// The alternative to a channel: check a shared list, and yield while it
+// is empty.
+local_executor::task produce_polled(local_executor& ex, safelist<uint64_t>& l, bool& done, size_t count, size_t burst)
+{
+	for (size_t i = 0; i < count; ++i) {
+		l.push_back(i);
+		if (i % burst == burst - 1) {
+			co_await ex.yield();
+		}
+	}
+	done = true;
+}
+
+local_executor::task consume_polled(local_executor& ex, safelist<uint64_t>& l, bool& done)
+{
+	uint64_t sum = 0;
+	for (;;) {
+		if (l.empty()) {
+			if (done) {
+				break;
+			}
+			co_await ex.yield();
+			continue;
+		}
+		sum += l.front();
+		l.pop_front();
+	}
+	sink = sum;
+}
+
+static void report(const char* name, size_t count, size_t resumed, chrono::duration<double> elapsed)
+{
+	cout << name << ": " << count / elapsed.count() << " elements/s, "
+		<< static_cast<double>(resumed) / count << " resumptions/element" << endl;
+}
+
+// Each run also has idle consumers, waiting on lists or channels that
+// nothing is pushed to until the end.
+static void bench_polled(size_t count, size_t burst, size_t idle)
+{
+	local_executor ex;
+	safelist<uint64_t> l;
+	list<safelist<uint64_t>> others(idle);
+	bool done = false;
+
+	const auto start = chrono::steady_clock::now();
+	ex.spawn(consume_polled(ex, l, done));
+	for (auto& other : others) {
+		ex.spawn(consume_polled(ex, other, done));
+	}
+	ex.spawn(produce_polled(ex, l, done, count, burst));
+	const auto resumed = ex.run();
+	report("polled safelist", count, resumed, chrono::steady_clock::now() - start);
+}
+
+// A batch of 0 pops one element at a time.
+static void bench_channel(const char* name, size_t count, size_t burst, size_t idle, size_t capacity, size_t batch)
+{
+	local_executor ex;
+	safe_channel<uint64_t> ch(ex, capacity);
+	list<safe_channel<uint64_t>> others;
+
+	const auto start = chrono::steady_clock::now();
+	if (batch) {
+		ex.spawn(consume_batches(ch, batch));
+	} else {
+		ex.spawn(consume(ch));
+	}
+	for (size_t i = 0; i < idle; ++i) {
+		others.emplace_back(ex);
+		ex.spawn(consume(others.back()));
+	}
+	ex.spawn(produce(ex, ch, count, burst));
+	const auto resumed = ex.run();
+	for (auto& other : others) {
+		other.close();
+	}
+	ex.run();
+	report(name, count, resumed, chrono::steady_clock::now() - start);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		cerr << "Usage: " << argv[0] << " COUNT [BURST [IDLE [CAPACITY [BATCH]]]]" << endl;
+		return 1;
+	}
+
+	const size_t count = strtoull(argv[1], nullptr, 10);
+	const size_t burst = argc > 2 ? strtoull(argv[2], nullptr, 10) : 16;
+	const size_t idle = argc > 3 ? strtoull(argv[3], nullptr, 10) : 0;
+	const size_t capacity = argc > 4 ? strtoull(argv[4], nullptr, 10) : 64;
+	const size_t batch = argc > 5 ? strtoull(argv[5], nullptr, 10) : 64;
+
+	bench_polled(count, burst, idle);
+	bench_channel("unbounded pop", count, burst, idle, 0, 0);
+	bench_channel("bounded pop", count, burst, idle, capacity, 0);
+	bench_channel("unbounded pop_many", count, burst, idle, 0, batch);
+	bench_channel("bounded pop_many", count, burst, idle, capacity, batch);
+
+	return 0;
+}
@@ -0,0 +1,639 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+
+// Intrusive list: elements embed an intrusive_hook and are linked through
+// it, so inserting and removing never allocate. The list does not own its
+// elements; they live wherever the caller keeps them.
+//
+// Safety comes from the hooks knowing about the iterators that point at
+// them. Unlinking an element, by erasing it or by destroying it, detaches
+// those iterators, and using a detached iterator throws instead of touching
+// freed memory. A destroyed element unlinks itself from its list.
+//
+// An element can be on several lists at once by deriving from several
+// hooks, told apart by their tag:
+//
+//     struct by_id;
+//     struct by_age;
+//     struct item : intrusive_hook<by_id>, intrusive_hook<by_age> { ... };
+//
+//     intrusive_safelist<item, by_id> ids;
+//     intrusive_safelist<item, by_age> ages;
+//
+// Since elements can leave a list on their own, size() counts them.
+template<class Tag = void>
+class intrusive_hook
+{
+	public:
+		intrusive_hook() noexcept: prev(nullptr), next(nullptr), cursors(nullptr), head(false) {}
+
+		// List membership belongs to the object, not its value, so copies
+		// start out unlinked and assignment leaves the links alone.
+		intrusive_hook(const intrusive_hook&) noexcept: intrusive_hook() {}
+		intrusive_hook& operator=(const intrusive_hook&) noexcept { return *this; }
+
+		~intrusive_hook() { unlink(); }
+
+		bool is_linked() const noexcept { return next != nullptr; }
+
+		// Takes the element off its list and detaches iterators to it.
+		void unlink() noexcept;
+
+	private:
+		template<class, class> friend class intrusive_safelist;
+
+		// Position of an iterator. The cursors at a hook form a list of
+		// their own, so that the hook can detach them.
+		struct cursor
+		{
+			intrusive_hook* node;
+			cursor* prev;
+			cursor* next;
+
+			cursor(intrusive_hook* node = nullptr) noexcept { attach(node); }
+			cursor(const cursor& other) noexcept { attach(other.node); }
+			cursor& operator=(const cursor& other) noexcept;
+			~cursor() { detach(); }
+
+			void attach(intrusive_hook* node) noexcept;
+			void detach() noexcept;
+			void move_to(intrusive_hook* node) noexcept;
+
+			// The hook, or an exception if the cursor was detached.
+			intrusive_hook* linked() const;
+			// The same, but also throws for the list's sentinel.
+			intrusive_hook* element() const;
+		};
+
+		intrusive_hook* prev;
+		intrusive_hook* next;
+		cursor* cursors;
+		// Set on the list's own sentinel, which has no element around it.
+		bool head;
+
+		void detach_cursors() noexcept;
+		void link_before(intrusive_hook* pos) noexcept;
+		void relink_before(intrusive_hook* pos) noexcept;
+};
+
+template<class T, class Tag = void>
+class intrusive_safelist
+{
+	public:
+		typedef T value_type;
+		typedef std::size_t size_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef intrusive_hook<Tag> hook_type;
+
+		class iterator;
+		class const_iterator;
+		typedef std::reverse_iterator<iterator> reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+		intrusive_safelist() noexcept;
+		intrusive_safelist(const intrusive_safelist&) = delete;
+		intrusive_safelist(intrusive_safelist&& other) noexcept;
+		intrusive_safelist& operator=(const intrusive_safelist&) = delete;
+		intrusive_safelist& operator=(intrusive_safelist&& other) noexcept;
+		~intrusive_safelist();
+
+		void swap(intrusive_safelist& other) noexcept;
+
+		// Linking an element that is already on a list through this hook
+		// throws std::logic_error.
+		void push_front(value_type& value);
+		void push_back(value_type& value);
+		iterator insert(const_iterator pos, value_type& value);
+
+		void pop_front();
+		void pop_back();
+		iterator erase(const_iterator pos);
+		iterator erase(const_iterator first, const_iterator last);
+
+		template<class UnaryPredicate>
+		void remove_if(UnaryPredicate pred);
+
+		void splice(const_iterator pos, intrusive_safelist& other);
+		void splice(const_iterator pos, intrusive_safelist& other, const_iterator it);
+
+		// Unlinks every element; the elements themselves are untouched.
+		void clear();
+
+		size_type size() const;
+		bool empty() const { return head.next == &head; };
+
+		value_type& front();
+		value_type& back();
+		const value_type& front() const;
+		const value_type& back() const;
+
+		// Iterator to an element on this list.
+		iterator iterator_to(value_type& value);
+		const_iterator iterator_to(const value_type& value) const;
+
+		iterator begin();
+		iterator end();
+		const_iterator begin() const;
+		const_iterator end() const;
+		const_iterator cbegin() const { return begin(); };
+		const_iterator cend() const { return end(); };
+
+		reverse_iterator rbegin() { return reverse_iterator(end()); };
+		reverse_iterator rend() { return reverse_iterator(begin()); };
+		const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); };
+		const_reverse_iterator rend() const { return const_reverse_iterator(begin()); };
+
+	private:
+		hook_type head;
+
+		static hook_type* hook_of(value_type& value) { return &static_cast<hook_type&>(value); };
+		static hook_type* hook_of(const value_type& value) { return const_cast<hook_type*>(&static_cast<const hook_type&>(value)); };
+		static value_type* value_of(hook_type* hook) { return static_cast<value_type*>(hook); };
+
+		// Takes over the elements of other, which must be empty itself.
+		void take(intrusive_safelist& other) noexcept;
+};
+
+template<class T, class Tag>
+class intrusive_safelist<T, Tag>::iterator
+{
+	public:
+		friend intrusive_safelist;
+		friend intrusive_safelist::const_iterator;
+
+		typedef std::ptrdiff_t difference_type;
+		typedef T value_type;
+		typedef T* pointer;
+		typedef T& reference;
+		typedef std::bidirectional_iterator_tag iterator_category;
+
+		iterator() = default;
+
+		iterator& operator++();
+		iterator operator++(int);
+		iterator& operator--();
+		iterator operator--(int);
+
+		reference operator*() const { return *value_of(pos.element()); };
+		pointer operator->() const { return value_of(pos.element()); };
+		bool operator==(const iterator& other) const { return pos.node == other.pos.node; };
+		bool operator!=(const iterator& other) const { return pos.node != other.pos.node; };
+
+	private:
+		typename hook_type::cursor pos;
+
+		explicit iterator(hook_type* node): pos(node) {};
+};
+
+template<class T, class Tag>
+class intrusive_safelist<T, Tag>::const_iterator
+{
+	public:
+		friend intrusive_safelist;
+
+		typedef std::ptrdiff_t difference_type;
+		typedef const T value_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+		typedef std::bidirectional_iterator_tag iterator_category;
+
+		const_iterator() = default;
+		const_iterator(const iterator& it): pos(it.pos) {};
+
+		const_iterator& operator++();
+		const_iterator operator++(int);
+		const_iterator& operator--();
+		const_iterator operator--(int);
+
+		reference operator*() const { return *value_of(pos.element()); };
+		pointer operator->() const { return value_of(pos.element()); };
+		bool operator==(const const_iterator& other) const { return pos.node == other.pos.node; };
+		bool operator!=(const const_iterator& other) const { return pos.node != other.pos.node; };
+
+	private:
+		typename hook_type::cursor pos;
+
+		explicit const_iterator(hook_type* node): pos(node) {};
+};
+
+// Hook functions
+template<class Tag>
+void intrusive_hook<Tag>::unlink() noexcept
+{
+	detach_cursors();
+	if (next) {
+		next->prev = prev;
+		prev->next = next;
+		next = prev = nullptr;
+	}
+}
+
+template<class Tag>
+void intrusive_hook<Tag>::detach_cursors() noexcept
+{
+	while (cursors) {
+		auto c = cursors;
+		cursors = c->next;
+		c->node = nullptr;
+		c->prev = c->next = nullptr;
+	}
+}
+
+template<class Tag>
+void intrusive_hook<Tag>::link_before(intrusive_hook* pos) noexcept
+{
+	prev = pos->prev;
+	next = pos;
+	prev->next = this;
+	pos->prev = this;
+}
+
+// Moves a linked hook, keeping the iterators that point at it.
+template<class Tag>
+void intrusive_hook<Tag>::relink_before(intrusive_hook* pos) noexcept
+{
+	next->prev = prev;
+	prev->next = next;
+	link_before(pos);
+}
+
+template<class Tag>
+typename intrusive_hook<Tag>::cursor& intrusive_hook<Tag>::cursor::operator=(const cursor& other) noexcept
+{
+	if (this != &other) {
+		move_to(other.node);
+	}
+
+	return *this;
+}
+
+template<class Tag>
+void intrusive_hook<Tag>::cursor::attach(intrusive_hook* node) noexcept
+{
+	this->node = node;
+	prev = nullptr;
+	next = node ? node->cursors : nullptr;
+	if (next) {
+		next->prev = this;
+	}
+	if (node) {
+		node->cursors = this;
+	}
+}
+
+template<class Tag>
+void intrusive_hook<Tag>::cursor::detach() noexcept
+{
+	if (!node) {
+		return;
+	}
+
+	if (prev) {
+		prev->next = next;
+	} else {
+		node->cursors = next;
+	}
+	if (next) {
+		next->prev = prev;
+	}
+
+	node = nullptr;
+}
+
+template<class Tag>
+void intrusive_hook<Tag>::cursor::move_to(intrusive_hook* node) noexcept
+{
+	detach();
+	attach(node);
+}
+
+template<class Tag>
+intrusive_hook<Tag>* intrusive_hook<Tag>::cursor::linked() const
+{
+	if (!node) {
+		throw std::range_error("Iterator was detached from its element");
+	}
+
+	return node;
+}
+
+template<class Tag>
+intrusive_hook<Tag>* intrusive_hook<Tag>::cursor::element() const
+{
+	if (linked()->head) {
+		throw std::range_error("Unable to dereference end()");
+	}
+
+	return node;
+}
+
+// List functions
+template<class T, class Tag>
+intrusive_safelist<T, Tag>::intrusive_safelist() noexcept
+{
+	head.prev = head.next = &head;
+	head.head = true;
+}
+
+template<class T, class Tag>
+intrusive_safelist<T, Tag>::intrusive_safelist(intrusive_safelist&& other) noexcept: intrusive_safelist()
+{
+	take(other);
+}
+
+template<class T, class Tag>
+intrusive_safelist<T, Tag>& intrusive_safelist<T, Tag>::operator=(intrusive_safelist&& other) noexcept
+{
+	if (&other != this) {
+		clear();
+		take(other);
+	}
+
+	return *this;
+}
+
+template<class T, class Tag>
+intrusive_safelist<T, Tag>::~intrusive_safelist()
+{
+	clear();
+}
+
+template<class T, class Tag>
+void intrusive_safelist<T, Tag>::swap(intrusive_safelist& other) noexcept
+{
+	intrusive_safelist tmp(std::move(other));
+	other.take(*this);
+	take(tmp);
+}
+
+template<class T, class Tag>
+void swap(intrusive_safelist<T, Tag>& a, intrusive_safelist<T, Tag>& b)
+{
+	a.swap(b);
+}
+
+template<class T, class Tag>
+void intrusive_safelist<T, Tag>::take(intrusive_safelist& other) noexcept
+{
+	if (other.empty()) {
+		return;
+	}
+
+	head.next = other.head.next;
+	head.prev = other.head.prev;
+	head.next->prev = &head;
+	head.prev->next = &head;
+	other.head.prev = other.head.next = &other.head;
+}
+
+template<class T, class Tag>
+void intrusive_safelist<T, Tag>::push_front(value_type& value)
+{
+	insert(begin(), value);
+}
+
+template<class T, class Tag>
+void intrusive_safelist<T, Tag>::push_back(value_type& value)
+{
+	insert(end(), value);
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::iterator intrusive_safelist<T, Tag>::insert(const_iterator pos, value_type& value)
+{
+	auto hook = hook_of(value);
+	if (hook->is_linked()) {
+		throw std::logic_error("Element is already in a list");
+	}
+	hook->link_before(pos.pos.linked());
+
+	return iterator(hook);
+}
+
+template<class T, class Tag>
+void intrusive_safelist<T, Tag>::pop_front()
+{
+	if (!empty()) {
+		head.next->unlink();
+	}
+}
+
+template<class T, class Tag>
+void intrusive_safelist<T, Tag>::pop_back()
+{
+	if (!empty()) {
+		head.prev->unlink();
+	}
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::iterator intrusive_safelist<T, Tag>::erase(const_iterator pos)
+{
+	auto hook = pos.pos.element();
+	iterator next(hook->next);
+	hook->unlink();
+
+	return next;
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::iterator intrusive_safelist<T, Tag>::erase(const_iterator first, const_iterator last)
+{
+	while (first != last) {
+		first = erase(first);
+	}
+
+	return iterator(last.pos.node);
+}
+
+template<class T, class Tag>
+template<class UnaryPredicate>
+void intrusive_safelist<T, Tag>::remove_if(UnaryPredicate pred)
+{
+	for (auto hook = head.next; hook != &head;) {
+		auto next = hook->next;
+		if (pred(*value_of(hook))) {
+			hook->unlink();
+		}
+		hook = next;
+	}
+}
+
+template<class T, class Tag>
+void intrusive_safelist<T, Tag>::splice(const_iterator pos, intrusive_safelist& other)
+{
+	if (&other == this || other.empty()) {
+		return;
+	}
+
+	auto before = pos.pos.linked();
+
+	auto first = other.head.next;
+	auto last = other.head.prev;
+	other.head.prev = other.head.next = &other.head;
+
+	first->prev = before->prev;
+	before->prev->next = first;
+	last->next = before;
+	before->prev = last;
+}
+
+template<class T, class Tag>
+void intrusive_safelist<T, Tag>::splice(const_iterator pos, intrusive_safelist&, const_iterator it)
+{
+	auto hook = it.pos.element();
+	auto before = pos.pos.linked();
+
+	if (hook != before && hook->next != before) {
+		hook->relink_before(before);
+	}
+}
+
+template<class T, class Tag>
+void intrusive_safelist<T, Tag>::clear()
+{
+	while (!empty()) {
+		head.next->unlink();
+	}
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::size_type intrusive_safelist<T, Tag>::size() const
+{
+	size_type count = 0;
+	for (auto hook = head.next; hook != &head; hook = hook->next) {
+		++count;
+	}
+
+	return count;
+}
+
+template<class T, class Tag>
+T& intrusive_safelist<T, Tag>::front()
+{
+	return *begin();
+}
+
+template<class T, class Tag>
+T& intrusive_safelist<T, Tag>::back()
+{
+	return *--end();
+}
+
+template<class T, class Tag>
+const T& intrusive_safelist<T, Tag>::front() const
+{
+	return *begin();
+}
+
+template<class T, class Tag>
+const T& intrusive_safelist<T, Tag>::back() const
+{
+	return *--end();
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::iterator intrusive_safelist<T, Tag>::iterator_to(value_type& value)
+{
+	return iterator(hook_of(value));
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::const_iterator intrusive_safelist<T, Tag>::iterator_to(const value_type& value) const
+{
+	return const_iterator(hook_of(value));
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::iterator intrusive_safelist<T, Tag>::begin()
+{
+	return iterator(head.next);
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::iterator intrusive_safelist<T, Tag>::end()
+{
+	return iterator(&head);
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::const_iterator intrusive_safelist<T, Tag>::begin() const
+{
+	return const_iterator(head.next);
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::const_iterator intrusive_safelist<T, Tag>::end() const
+{
+	return const_iterator(const_cast<hook_type*>(&head));
+}
+
+// Iterator functions
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::iterator& intrusive_safelist<T, Tag>::iterator::operator++()
+{
+	pos.move_to(pos.linked()->next);
+	return *this;
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::iterator intrusive_safelist<T, Tag>::iterator::operator++(int)
+{
+	iterator copy = *this;
+	++(*this);
+
+	return copy;
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::iterator& intrusive_safelist<T, Tag>::iterator::operator--()
+{
+	pos.move_to(pos.linked()->prev);
+	return *this;
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::iterator intrusive_safelist<T, Tag>::iterator::operator--(int)
+{
+	iterator copy = *this;
+	--(*this);
+
+	return copy;
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::const_iterator& intrusive_safelist<T, Tag>::const_iterator::operator++()
+{
+	pos.move_to(pos.linked()->next);
+	return *this;
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::const_iterator intrusive_safelist<T, Tag>::const_iterator::operator++(int)
+{
+	const_iterator copy = *this;
+	++(*this);
+
+	return copy;
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::const_iterator& intrusive_safelist<T, Tag>::const_iterator::operator--()
+{
+	pos.move_to(pos.linked()->prev);
+	return *this;
+}
+
+template<class T, class Tag>
+typename intrusive_safelist<T, Tag>::const_iterator intrusive_safelist<T, Tag>::const_iterator::operator--(int)
+{
+	const_iterator copy = *this;
+	--(*this);
+
+	return copy;
+}
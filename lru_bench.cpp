@@ -0,0 +1,114 @@
+#include "safe_lru_cache.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// The usual std::list LRU, for comparison.
+template<class Key, class Value>
+class list_lru_cache
+{
+	public:
+		explicit list_lru_cache(size_t capacity): m_capacity(capacity), m_evictions(0) {};
+
+		bool find(const Key& key)
+		{
+			auto found = index.find(key);
+			if (found == index.end()) {
+				return false;
+			}
+
+			order.splice(order.begin(), order, found->second);
+			return true;
+		}
+
+		void put(const Key& key, const Value& value)
+		{
+			auto found = index.find(key);
+			if (found != index.end()) {
+				found->second->second = value;
+				order.splice(order.begin(), order, found->second);
+				return;
+			}
+
+			order.emplace_front(key, value);
+			index.emplace(key, order.begin());
+
+			if (order.size() > m_capacity) {
+				index.erase(order.back().first);
+				order.pop_back();
+				++m_evictions;
+			}
+		}
+
+		size_t evictions() const { return m_evictions; };
+
+	private:
+		list<pair<Key, Value>> order;
+		unordered_map<Key, typename list<pair<Key, Value>>::iterator> index;
+		size_t m_capacity;
+		size_t m_evictions;
+};
+
+bool lookup(safe_lru_cache<uint64_t, uint64_t>& cache, uint64_t key)
+{
+	return cache.find(key) != cache.end();
+}
+
+bool lookup(list_lru_cache<uint64_t, uint64_t>& cache, uint64_t key)
+{
+	return cache.find(key);
+}
+
+template<class Cache>
+void bench(const char* name, const vector<uint64_t>& keys, size_t capacity)
+{
+	Cache cache(capacity);
+	size_t hits = 0, misses = 0;
+
+	auto start = chrono::steady_clock::now();
+	for (auto key : keys) {
+		if (lookup(cache, key)) {
+			++hits;
+		} else {
+			++misses;
+			cache.put(key, key);
+		}
+	}
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+	cout << name << ": " << keys.size() / elapsed.count() << " ops/s, "
+		<< hits << " hits, " << misses << " misses, "
+		<< cache.evictions() << " evictions" << endl;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4) {
+		cerr << "Usage: " << argv[0] << " OPERATIONS KEYSPACE CAPACITY" << endl;
+		return 1;
+	}
+
+	const size_t operations = strtoull(argv[1], nullptr, 10);
+	const uint64_t keyspace = strtoull(argv[2], nullptr, 10);
+	const size_t capacity = strtoull(argv[3], nullptr, 10);
+
+	// Skewed key popularity: small keys are requested far more often.
+	mt19937_64 r((random_device())());
+	vector<uint64_t> keys;
+	keys.reserve(operations);
+	for (size_t i = 0; i < operations; ++i) {
+		keys.push_back(r() % (r() % keyspace + 1));
+	}
+
+	bench<safe_lru_cache<uint64_t, uint64_t>>("safe_lru_cache", keys, capacity);
+	bench<list_lru_cache<uint64_t, uint64_t>>("std::list LRU", keys, capacity);
+
+	return 0;
+}
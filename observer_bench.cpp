@@ -0,0 +1,87 @@
+#include "safelist.hpp"
+#include "weak_observer_list.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Notifies a large set of listeners over and over, while some of them die
+// between notifications; reports notifications per second for a list
+// pruned with remove_if on every notification and a weak_observer_list.
+
+struct listener
+{
+	uint64_t seen = 0;
+};
+
+// Keeps the notifications from being optimised away.
+volatile uint64_t sink;
+
+template<class Notify>
+double run(size_t count, size_t rounds, size_t deaths, Notify notify, vector<shared_ptr<listener>>& listeners)
+{
+	mt19937 r(42);
+	const auto start = chrono::steady_clock::now();
+	for (size_t i = 0; i < rounds; ++i) {
+		for (size_t j = 0; j < deaths; ++j) {
+			listeners[r() % count].reset();
+		}
+		sink = notify();
+	}
+
+	const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return rounds / elapsed.count();
+}
+
+double bench_pruned(size_t count, size_t rounds, size_t deaths)
+{
+	vector<shared_ptr<listener>> listeners;
+	safelist<weak_ptr<listener>> l;
+	for (size_t i = 0; i < count; ++i) {
+		listeners.push_back(make_shared<listener>());
+		l.push_back(listeners.back());
+	}
+
+	return run(count, rounds, deaths, [&] {
+		l.remove_if([](const weak_ptr<listener>& w) { return w.expired(); });
+		uint64_t notified = 0;
+		for (auto& w : l) {
+			if (auto p = w.lock()) {
+				++p->seen;
+				++notified;
+			}
+		}
+		return notified;
+	}, listeners);
+}
+
+double bench_observer_list(size_t count, size_t rounds, size_t deaths)
+{
+	vector<shared_ptr<listener>> listeners;
+	weak_observer_list<listener> l;
+	for (size_t i = 0; i < count; ++i) {
+		listeners.push_back(make_shared<listener>());
+		l.add(listeners.back());
+	}
+
+	return run(count, rounds, deaths, [&] {
+		return l.notify([](listener& p) { ++p.seen; });
+	}, listeners);
+}
+
+int main(int argc, char** argv)
+{
+	const size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+	const size_t rounds = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100;
+	const size_t deaths = argc > 3 ? strtoull(argv[3], nullptr, 10) : 100;
+
+	cout << "remove_if every notification: " << bench_pruned(count, rounds, deaths) << " notifications/s" << endl;
+	cout << "weak_observer_list: " << bench_observer_list(count, rounds, deaths) << " notifications/s" << endl;
+
+	return 0;
+}
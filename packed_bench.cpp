@@ -0,0 +1,97 @@
+#include "safelist.hpp"
+#include "packed_safelist.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <malloc.h>
+
+using namespace std;
+
+// Heap bytes in use, as the allocator sees them.
+static size_t live_bytes;
+
+void* operator new(size_t size)
+{
+	void* p = malloc(size ? size : 1);
+	if (!p) {
+		throw bad_alloc();
+	}
+	live_bytes += malloc_usable_size(p);
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	if (p) {
+		live_bytes -= malloc_usable_size(p);
+		free(p);
+	}
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+// Keeps the scans from being optimised away.
+volatile uint64_t sink;
+
+template<class List>
+void bench(const char* name, const vector<uint64_t>& ids, int scans)
+{
+	typedef chrono::steady_clock clock;
+
+	const auto before = live_bytes;
+	auto start = clock::now();
+	List l;
+	for (auto id : ids) {
+		l.push_back(id);
+	}
+	const chrono::duration<double> built = clock::now() - start;
+	const auto bytes = live_bytes - before;
+
+	start = clock::now();
+	for (int i = 0; i < scans; ++i) {
+		uint64_t sum = 0;
+		for (uint64_t id : l) {
+			sum += id;
+		}
+		sink = sum;
+	}
+	const chrono::duration<double> scanned = clock::now() - start;
+
+	cout << name << ": " << static_cast<double>(bytes) / ids.size() << " bytes/element, built in "
+		<< built.count() << " s, " << ids.size() * scans / scanned.count() << " elements/s scanned" << endl;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		cerr << "Usage: " << argv[0] << " COUNT [MAX_GAP [SCANS]]" << endl;
+		return 1;
+	}
+
+	const size_t count = strtoull(argv[1], nullptr, 10);
+	const uint64_t max_gap = argc > 2 ? strtoull(argv[2], nullptr, 10) : 16;
+	const int scans = argc > 3 ? atoi(argv[3]) : 10;
+
+	// Increasing IDs with random gaps, starting from a timestamp-like value.
+	mt19937_64 r((random_device())());
+	vector<uint64_t> ids;
+	ids.reserve(count);
+	uint64_t id = 1500000000000000;
+	for (size_t i = 0; i < count; ++i) {
+		id += 1 + r() % max_gap;
+		ids.push_back(id);
+	}
+
+	bench<safelist<uint64_t>>("safelist", ids, scans);
+	bench<packed_safelist<uint64_t>>("packed_safelist", ids, scans);
+
+	return 0;
+}
@@ -0,0 +1,1060 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// A list of integers stored in compressed chunks.
+//
+// Elements live in chunks of a couple of hundred bytes. The first value of
+// a chunk is stored as is, and every following one as the zigzagged varint
+// of its difference with its predecessor. Sequences that change slowly,
+// like IDs and timestamps, take a byte or two per element where safelist
+// spends two allocations, and scanning them touches far less memory.
+//
+// Chunks are linked like the entries of a safelist. Values are not
+// addressable, so iterators dereference to a proxy that converts to
+// value_type and can be assigned to. An iterator keeps its chunk alive and
+// denotes a position in it rather than an element: inserting or erasing
+// in a chunk shifts the iterators to later positions in it, as with
+// std::vector. Using an iterator whose position has gone throws
+// std::range_error.
+template<class T>
+class packed_safelist
+{
+	static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value,
+		"packed_safelist only holds integers");
+
+	public:
+		typedef T value_type;
+		typedef std::size_t size_type;
+		typedef std::ptrdiff_t difference_type;
+		class reference;
+		typedef value_type const_reference;
+
+		class iterator;
+		class const_iterator;
+		typedef std::reverse_iterator<iterator> reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+		// Constructors
+		packed_safelist() noexcept: m_size(0) {};
+		packed_safelist(size_type count, value_type value);
+		template<class InputIt,
+			typename = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+				packed_safelist(InputIt first, InputIt last);
+		packed_safelist(std::initializer_list<value_type> ilist);
+		packed_safelist(const packed_safelist& other);
+		packed_safelist(packed_safelist&& other) noexcept;
+
+		~packed_safelist();
+
+		packed_safelist& operator=(const packed_safelist& other);
+		packed_safelist& operator=(packed_safelist&& other) noexcept;
+
+		void swap(packed_safelist& other) noexcept;
+
+		// Element access
+		value_type front() const;
+		value_type back() const;
+
+		// Iterators
+		iterator begin();
+		const_iterator begin() const;
+		const_iterator cbegin() const { return begin(); };
+		iterator end();
+		const_iterator end() const;
+		const_iterator cend() const { return end(); };
+		reverse_iterator rbegin() { return reverse_iterator(end()); };
+		const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); };
+		const_reverse_iterator crbegin() const { return rbegin(); };
+		reverse_iterator rend() { return reverse_iterator(begin()); };
+		const_reverse_iterator rend() const { return const_reverse_iterator(begin()); };
+		const_reverse_iterator crend() const { return rend(); };
+
+		// Capacity
+		size_type size() const { return m_size; };
+		bool empty() const { return m_size == 0; };
+		size_type max_size() const { return std::numeric_limits<difference_type>::max(); };
+
+		// Modifiers
+		void clear();
+
+		void push_back(value_type value);
+		void push_front(value_type value);
+		void pop_back();
+		void pop_front();
+
+		iterator insert(const_iterator pos, value_type value);
+		iterator erase(const_iterator pos);
+		iterator erase(const_iterator first, const_iterator last);
+
+		// Comparisons
+		bool operator==(const packed_safelist& other) const;
+		bool operator!=(const packed_safelist& other) const { return !(*this == other); };
+		bool operator<(const packed_safelist& other) const;
+		bool operator<=(const packed_safelist& other) const { return !(other < *this); };
+		bool operator>(const packed_safelist& other) const { return other < *this; };
+		bool operator>=(const packed_safelist& other) const { return !(*this < other); };
+
+	private:
+		struct chunk;
+		struct position;
+		typedef std::shared_ptr<chunk> link_t;
+		typedef typename std::make_unsigned<T>::type bits_t;
+
+		// Bytes of encoded differences in a chunk, which bounds the number
+		// of elements in it as well.
+		static const std::size_t chunk_bytes = 192;
+		static const std::size_t max_count = chunk_bytes + 1;
+		static const unsigned short no_edit = std::numeric_limits<unsigned short>::max();
+
+		// Ends the ring of chunks. Created on first use.
+		link_t m_sentinel;
+		size_type m_size;
+
+		const link_t& sentinel();
+		void release();
+
+		// The position an iterator refers to, or the chunk and index it
+		// would be inserted at for end().
+		static position locate(link_t c, size_type index);
+
+		// Encoding
+		static bits_t delta(value_type from, value_type to);
+		static value_type add(value_type from, bits_t z);
+		static value_type subtract(value_type to, bits_t z);
+		static std::size_t varint_size(bits_t z);
+		static unsigned char* put_varint(unsigned char* p, bits_t z);
+		static const unsigned char* get_varint(const unsigned char* p, bits_t& z);
+		static std::size_t encoded_size(const value_type* values, size_type count);
+
+		static size_type decode(const chunk& c, value_type* values);
+		static size_type fill(chunk& c, const value_type* values, size_type count, std::size_t limit);
+		static void store(link_t c, const value_type* values, size_type count);
+		static void assign_at(const link_t& c, size_type index, value_type value);
+
+		// Chunk links
+		static link_t insert_chunk(const link_t& after);
+		static void unlink_chunk(const link_t& c);
+		static void retire(chunk& c);
+};
+
+template<class T>
+struct packed_safelist<T>::chunk
+{
+	std::weak_ptr<chunk> prev;
+	link_t next;
+
+	value_type first;
+	value_type last;
+
+	// Bumped whenever encoded data moves. If only one element was
+	// assigned to, the edit fields tell how far the positions after it
+	// moved, so iterators can follow without decoding the chunk again.
+	// If that split the chunk, the elements from kept on went to spill.
+	unsigned stamp;
+	unsigned short count;
+	unsigned short bytes;
+	unsigned short edit;
+	short shift_at;
+	short shift_after;
+	unsigned short kept;
+	value_type edited;
+	std::weak_ptr<chunk> spill;
+
+	unsigned char data[chunk_bytes];
+
+	chunk(): first(), last(), stamp(0), count(0), bytes(0), edit(no_edit), shift_at(0), shift_after(0), kept(no_edit), edited()
+	{
+	}
+
+	// Invalidates the positions iterators have cached.
+	void moved()
+	{
+		++stamp;
+		edit = no_edit;
+		kept = no_edit;
+		spill.reset();
+	}
+};
+
+// A chunk, an index into it and, while the chunk's stamp is unchanged, the
+// value at that index and the offset just past its encoding.
+template<class T>
+struct packed_safelist<T>::position
+{
+	static const unsigned short unknown = std::numeric_limits<unsigned short>::max();
+
+	link_t c;
+	unsigned short index = 0;
+	unsigned short offset = unknown;
+	unsigned stamp = 0;
+	value_type value = value_type();
+
+	position() = default;
+	position(const link_t& c, size_type index): c(c), index(static_cast<unsigned short>(index)) {};
+
+	void refresh();
+	void seek();
+	value_type get();
+	void increment();
+	void decrement();
+
+	bool operator==(const position& other) const { return c == other.c && index == other.index; };
+};
+
+template<class T>
+class packed_safelist<T>::reference
+{
+	public:
+		friend packed_safelist<T>;
+		friend packed_safelist<T>::iterator;
+
+		reference(const reference&) = default;
+
+		operator value_type() const { return value; };
+
+		// Re-encodes the element's chunk.
+		reference& operator=(value_type v)
+		{
+			assign_at(c, index, v);
+			value = v;
+			return *this;
+		};
+		reference& operator=(const reference& other) { return *this = other.value; };
+		reference& operator+=(value_type v) { return *this = static_cast<value_type>(value + v); };
+		reference& operator-=(value_type v) { return *this = static_cast<value_type>(value - v); };
+
+	private:
+		link_t c;
+		size_type index;
+		value_type value;
+
+		reference(const link_t& c, size_type index, value_type value): c(c), index(index), value(value) {};
+};
+
+template<class T>
+class packed_safelist<T>::iterator
+{
+	public:
+		friend packed_safelist<T>;
+		friend packed_safelist<T>::const_iterator;
+
+		typedef std::ptrdiff_t difference_type;
+		typedef T value_type;
+		typedef void pointer;
+		typedef typename packed_safelist<T>::reference reference;
+		typedef std::bidirectional_iterator_tag iterator_category;
+
+		iterator() = default;
+
+		iterator& operator++() { pos.increment(); return *this; };
+		iterator operator++(int) { auto copy = *this; pos.increment(); return copy; };
+		iterator& operator--() { pos.decrement(); return *this; };
+		iterator operator--(int) { auto copy = *this; pos.decrement(); return copy; };
+
+		reference operator*() const
+		{
+			const auto v = pos.get();
+			return reference(pos.c, pos.index, v);
+		};
+		bool operator==(const iterator& other) const { return pos == other.pos; };
+		bool operator!=(const iterator& other) const { return !(pos == other.pos); };
+
+	private:
+		mutable position pos;
+
+		explicit iterator(const position& pos): pos(pos) {};
+		explicit iterator(const const_iterator& it): pos(it.pos) {};
+};
+
+template<class T>
+class packed_safelist<T>::const_iterator
+{
+	public:
+		friend packed_safelist<T>;
+		friend packed_safelist<T>::iterator;
+
+		typedef std::ptrdiff_t difference_type;
+		typedef T value_type;
+		typedef void pointer;
+		typedef T reference;
+		typedef std::bidirectional_iterator_tag iterator_category;
+
+		const_iterator() = default;
+		const_iterator(const iterator& it): pos(it.pos) {};
+
+		const_iterator& operator++() { pos.increment(); return *this; };
+		const_iterator operator++(int) { auto copy = *this; pos.increment(); return copy; };
+		const_iterator& operator--() { pos.decrement(); return *this; };
+		const_iterator operator--(int) { auto copy = *this; pos.decrement(); return copy; };
+
+		reference operator*() const { return pos.get(); };
+		bool operator==(const const_iterator& other) const { return pos == other.pos; };
+		bool operator!=(const const_iterator& other) const { return !(pos == other.pos); };
+
+	private:
+		mutable position pos;
+
+		explicit const_iterator(const position& pos): pos(pos) {};
+};
+
+// Positions
+template<class T>
+void packed_safelist<T>::position::refresh()
+{
+	if (offset != unknown && stamp + 1 == c->stamp && c->kept != no_edit && index >= c->kept) {
+		auto spill = c->spill.lock();
+		if (spill) {
+			// Follow the element into the chunk split off.
+			*this = locate(std::move(spill), index - c->kept);
+			return;
+		}
+	}
+
+	if (index >= c->count) {
+		// Past the end of the chunk, which only allows moving on.
+		offset = unknown;
+	} else if (offset == unknown || (stamp != c->stamp && (stamp + 1 != c->stamp || c->edit == no_edit))) {
+		seek();
+	} else if (stamp != c->stamp) {
+		if (index == c->edit) {
+			offset += c->shift_at;
+			value = c->edited;
+		} else if (index > c->edit) {
+			offset += c->shift_after;
+		}
+		stamp = c->stamp;
+	}
+}
+
+template<class T>
+void packed_safelist<T>::position::seek()
+{
+	value = c->first;
+	const unsigned char* p = c->data;
+	for (unsigned short i = 0; i < index; ++i) {
+		bits_t z;
+		p = get_varint(p, z);
+		value = add(value, z);
+	}
+
+	offset = static_cast<unsigned short>(p - c->data);
+	stamp = c->stamp;
+}
+
+template<class T>
+T packed_safelist<T>::position::get()
+{
+	if (!c) {
+		throw std::range_error("Iterator does not point to an element");
+	}
+
+	refresh();
+	if (index >= c->count) {
+		throw std::range_error("Iterator does not point to an element");
+	}
+
+	return value;
+}
+
+template<class T>
+void packed_safelist<T>::position::increment()
+{
+	if (!c) {
+		throw std::range_error("Unable to increment an invalid iterator");
+	}
+
+	refresh();
+	if (index + 1 < c->count) {
+		bits_t z;
+		const auto p = get_varint(c->data + offset, z);
+		value = add(value, z);
+		offset = static_cast<unsigned short>(p - c->data);
+		++index;
+	} else if (c->next) {
+		// Take a reference first, as c may be all that keeps next alive.
+		link_t next = c->next;
+		c = std::move(next);
+		index = 0;
+		offset = 0;
+		stamp = c->stamp;
+		value = c->first;
+	} else {
+		// The chunk has been removed from its list.
+		*this = position();
+	}
+}
+
+template<class T>
+void packed_safelist<T>::position::decrement()
+{
+	if (!c) {
+		throw std::range_error("Unable to decrement an invalid iterator");
+	}
+
+	refresh();
+	if (index > 0 && index < c->count) {
+		// The previous encoding ends where this one starts, and only its
+		// last byte lacks the continuation bit.
+		std::size_t start = offset - 1;
+		while (start > 0 && (c->data[start - 1] & 0x80)) {
+			--start;
+		}
+
+		bits_t z;
+		get_varint(c->data + start, z);
+		value = subtract(value, z);
+		offset = static_cast<unsigned short>(start);
+		--index;
+		return;
+	}
+
+	if (index == 0 || !c->count) {
+		auto prev = c->prev.lock();
+		if (!prev) {
+			*this = position();
+			return;
+		}
+		c = std::move(prev);
+	}
+
+	// The last element of c, if it has any.
+	index = c->count ? c->count - 1 : 0;
+	offset = c->bytes;
+	stamp = c->stamp;
+	value = c->last;
+}
+
+// Constructors
+template<class T>
+packed_safelist<T>::packed_safelist(size_type count, value_type value): packed_safelist()
+{
+	while (count--) {
+		push_back(value);
+	}
+}
+
+template<class T>
+template<class InputIt, typename>
+packed_safelist<T>::packed_safelist(InputIt first, InputIt last): packed_safelist()
+{
+	for (; first != last; ++first) {
+		push_back(*first);
+	}
+}
+
+template<class T>
+packed_safelist<T>::packed_safelist(std::initializer_list<value_type> ilist): packed_safelist(ilist.begin(), ilist.end())
+{
+}
+
+// Copies whole chunks, without decoding them.
+template<class T>
+packed_safelist<T>::packed_safelist(const packed_safelist& other): packed_safelist()
+{
+	if (other.empty()) {
+		return;
+	}
+
+	auto tail = sentinel();
+	for (auto c = other.m_sentinel->next; c != other.m_sentinel; c = c->next) {
+		tail = insert_chunk(tail);
+		tail->first = c->first;
+		tail->last = c->last;
+		tail->count = c->count;
+		tail->bytes = c->bytes;
+		std::memcpy(tail->data, c->data, c->bytes);
+	}
+	m_size = other.m_size;
+}
+
+template<class T>
+packed_safelist<T>::packed_safelist(packed_safelist&& other) noexcept:
+	m_sentinel(std::move(other.m_sentinel)),
+	m_size(other.m_size)
+{
+	other.m_size = 0;
+}
+
+template<class T>
+packed_safelist<T>::~packed_safelist()
+{
+	release();
+}
+
+template<class T>
+packed_safelist<T>& packed_safelist<T>::operator=(const packed_safelist& other)
+{
+	if (&other != this) {
+		packed_safelist copy(other);
+		swap(copy);
+	}
+
+	return *this;
+}
+
+template<class T>
+packed_safelist<T>& packed_safelist<T>::operator=(packed_safelist&& other) noexcept
+{
+	if (&other != this) {
+		release();
+		m_sentinel = std::move(other.m_sentinel);
+		m_size = other.m_size;
+		other.m_size = 0;
+	}
+
+	return *this;
+}
+
+template<class T>
+void packed_safelist<T>::swap(packed_safelist& other) noexcept
+{
+	std::swap(m_sentinel, other.m_sentinel);
+	std::swap(m_size, other.m_size);
+}
+
+// Element access
+template<class T>
+T packed_safelist<T>::front() const
+{
+	if (empty()) {
+		throw std::range_error("front() of an empty list");
+	}
+
+	return m_sentinel->next->first;
+}
+
+template<class T>
+T packed_safelist<T>::back() const
+{
+	if (empty()) {
+		throw std::range_error("back() of an empty list");
+	}
+
+	return m_sentinel->prev.lock()->last;
+}
+
+// Iterators
+template<class T>
+typename packed_safelist<T>::iterator packed_safelist<T>::begin()
+{
+	return m_sentinel ? iterator(locate(m_sentinel->next, 0)) : iterator();
+}
+
+template<class T>
+typename packed_safelist<T>::const_iterator packed_safelist<T>::begin() const
+{
+	return m_sentinel ? const_iterator(locate(m_sentinel->next, 0)) : const_iterator();
+}
+
+template<class T>
+typename packed_safelist<T>::iterator packed_safelist<T>::end()
+{
+	return m_sentinel ? iterator(position(m_sentinel, 0)) : iterator();
+}
+
+template<class T>
+typename packed_safelist<T>::const_iterator packed_safelist<T>::end() const
+{
+	return m_sentinel ? const_iterator(position(m_sentinel, 0)) : const_iterator();
+}
+
+// Modifiers
+template<class T>
+void packed_safelist<T>::clear()
+{
+	if (!m_sentinel) {
+		return;
+	}
+
+	// Release the chunks one at a time, rather than through a chain of
+	// destructors.
+	auto c = std::move(m_sentinel->next);
+	m_sentinel->next = m_sentinel;
+	m_sentinel->prev = m_sentinel;
+	++m_sentinel->stamp;
+
+	while (c != m_sentinel) {
+		auto next = std::move(c->next);
+		retire(*c);
+		c = std::move(next);
+	}
+
+	m_size = 0;
+}
+
+template<class T>
+void packed_safelist<T>::push_back(value_type value)
+{
+	const auto& s = sentinel();
+	auto tail = s->prev.lock();
+	if (tail != s) {
+		const auto z = delta(tail->last, value);
+		if (tail->bytes + varint_size(z) <= chunk_bytes) {
+			// Appending moves nothing, so positions stay valid.
+			tail->bytes = static_cast<unsigned short>(put_varint(tail->data + tail->bytes, z) - tail->data);
+			++tail->count;
+			tail->last = value;
+			++m_size;
+			return;
+		}
+	}
+
+	auto c = insert_chunk(tail);
+	c->first = c->last = value;
+	c->count = 1;
+	++m_size;
+}
+
+template<class T>
+void packed_safelist<T>::push_front(value_type value)
+{
+	const auto& s = sentinel();
+	auto head = s->next;
+	if (head != s) {
+		const auto z = delta(value, head->first);
+		const auto size = varint_size(z);
+		if (head->bytes + size <= chunk_bytes) {
+			std::memmove(head->data + size, head->data, head->bytes);
+			put_varint(head->data, z);
+			head->bytes = static_cast<unsigned short>(head->bytes + size);
+			++head->count;
+			head->first = value;
+			head->moved();
+			++m_size;
+			return;
+		}
+	}
+
+	auto c = insert_chunk(s);
+	c->first = c->last = value;
+	c->count = 1;
+	++m_size;
+}
+
+template<class T>
+void packed_safelist<T>::pop_back()
+{
+	if (empty()) {
+		return;
+	}
+
+	auto tail = m_sentinel->prev.lock();
+	if (tail->count == 1) {
+		unlink_chunk(tail);
+	} else {
+		std::size_t start = tail->bytes - 1;
+		while (start > 0 && (tail->data[start - 1] & 0x80)) {
+			--start;
+		}
+
+		bits_t z;
+		get_varint(tail->data + start, z);
+		tail->last = subtract(tail->last, z);
+		tail->bytes = static_cast<unsigned short>(start);
+		--tail->count;
+		tail->moved();
+	}
+	--m_size;
+}
+
+template<class T>
+void packed_safelist<T>::pop_front()
+{
+	if (empty()) {
+		return;
+	}
+
+	auto head = m_sentinel->next;
+	if (head->count == 1) {
+		unlink_chunk(head);
+	} else {
+		bits_t z;
+		const auto p = get_varint(head->data, z);
+		const auto size = static_cast<std::size_t>(p - head->data);
+		head->first = add(head->first, z);
+		std::memmove(head->data, p, head->bytes - size);
+		head->bytes = static_cast<unsigned short>(head->bytes - size);
+		--head->count;
+		head->moved();
+	}
+	--m_size;
+}
+
+template<class T>
+typename packed_safelist<T>::iterator packed_safelist<T>::insert(const_iterator pos, value_type value)
+{
+	auto& c = pos.pos.c;
+	if (!c || c == m_sentinel) {
+		push_back(value);
+		return --end();
+	}
+	if (!c->count) {
+		throw std::range_error("Unable to insert into a removed chunk");
+	}
+
+	// Past the end of a chunk counts as its end.
+	const size_type index = std::min<size_type>(pos.pos.index, c->count);
+
+	value_type values[max_count + 1];
+	const auto count = decode(*c, values);
+	std::copy_backward(values + index, values + count, values + count + 1);
+	values[index] = value;
+	store(c, values, count + 1);
+	++m_size;
+
+	return iterator(locate(c, index));
+}
+
+template<class T>
+typename packed_safelist<T>::iterator packed_safelist<T>::erase(const_iterator pos)
+{
+	auto c = pos.pos.c;
+	if (!c || c == m_sentinel) {
+		throw std::range_error("Unable to erase end()");
+	}
+	if (pos.pos.index >= c->count) {
+		throw std::range_error("Iterator does not point to an element");
+	}
+
+	size_type index = pos.pos.index;
+	if (c->count == 1) {
+		auto next = c->next;
+		unlink_chunk(c);
+		--m_size;
+		return iterator(locate(next, 0));
+	}
+
+	value_type values[max_count];
+	const auto count = decode(*c, values);
+	std::copy(values + index + 1, values + count, values + index);
+	store(c, values, count - 1);
+	--m_size;
+
+	// Fold a chunk that has become small into its predecessor, so that
+	// erasing does not leave the list in tiny chunks.
+	auto prev = c->prev.lock();
+	if (prev != m_sentinel) {
+		const auto z = delta(prev->last, c->first);
+		const auto size = varint_size(z);
+		if (prev->bytes + size + c->bytes <= chunk_bytes / 2) {
+			auto p = put_varint(prev->data + prev->bytes, z);
+			std::memcpy(p, c->data, c->bytes);
+			prev->bytes = static_cast<unsigned short>(prev->bytes + size + c->bytes);
+			index += prev->count;
+			prev->count = static_cast<unsigned short>(prev->count + c->count);
+			prev->last = c->last;
+			unlink_chunk(c);
+			c = std::move(prev);
+		}
+	}
+
+	return iterator(locate(c, index));
+}
+
+template<class T>
+typename packed_safelist<T>::iterator packed_safelist<T>::erase(const_iterator first, const_iterator last)
+{
+	// Erasing shifts the positions after first within its chunk, so count
+	// the elements beforehand.
+	size_type count = 0;
+	for (auto it = first; it != last; ++it) {
+		++count;
+	}
+
+	iterator it(first);
+	while (count--) {
+		it = erase(it);
+	}
+
+	return it;
+}
+
+// Comparisons
+template<class T>
+bool packed_safelist<T>::operator==(const packed_safelist& other) const
+{
+	return size() == other.size() && std::equal(begin(), end(), other.begin());
+}
+
+template<class T>
+bool packed_safelist<T>::operator<(const packed_safelist& other) const
+{
+	return std::lexicographical_compare(begin(), end(), other.begin(), other.end());
+}
+
+// Private helpers
+template<class T>
+const typename packed_safelist<T>::link_t& packed_safelist<T>::sentinel()
+{
+	if (!m_sentinel) {
+		m_sentinel = std::make_shared<chunk>();
+		m_sentinel->next = m_sentinel;
+		m_sentinel->prev = m_sentinel;
+	}
+
+	return m_sentinel;
+}
+
+// Frees the chunks and breaks the sentinel's link to itself.
+template<class T>
+void packed_safelist<T>::release()
+{
+	if (m_sentinel) {
+		clear();
+		m_sentinel->next.reset();
+		m_sentinel->prev.reset();
+		m_sentinel.reset();
+	}
+}
+
+template<class T>
+typename packed_safelist<T>::position packed_safelist<T>::locate(link_t c, size_type index)
+{
+	while (index >= c->count && c->count) {
+		index -= c->count;
+		c = c->next;
+	}
+
+	position pos(c, index);
+	if (c->count) {
+		pos.seek();
+	}
+
+	return pos;
+}
+
+template<class T>
+typename packed_safelist<T>::bits_t packed_safelist<T>::delta(value_type from, value_type to)
+{
+	const bits_t d = static_cast<bits_t>(static_cast<bits_t>(to) - static_cast<bits_t>(from));
+	const bits_t sign = static_cast<bits_t>(0 - static_cast<bits_t>(d >> (std::numeric_limits<bits_t>::digits - 1)));
+
+	return static_cast<bits_t>(static_cast<bits_t>(d << 1) ^ sign);
+}
+
+template<class T>
+T packed_safelist<T>::add(value_type from, bits_t z)
+{
+	const bits_t d = static_cast<bits_t>((z >> 1) ^ static_cast<bits_t>(0 - (z & 1)));
+
+	return static_cast<value_type>(static_cast<bits_t>(static_cast<bits_t>(from) + d));
+}
+
+template<class T>
+T packed_safelist<T>::subtract(value_type to, bits_t z)
+{
+	const bits_t d = static_cast<bits_t>((z >> 1) ^ static_cast<bits_t>(0 - (z & 1)));
+
+	return static_cast<value_type>(static_cast<bits_t>(static_cast<bits_t>(to) - d));
+}
+
+template<class T>
+std::size_t packed_safelist<T>::varint_size(bits_t z)
+{
+	std::size_t size = 1;
+	for (; z >= 0x80; z = static_cast<bits_t>(z >> 7)) {
+		++size;
+	}
+
+	return size;
+}
+
+template<class T>
+unsigned char* packed_safelist<T>::put_varint(unsigned char* p, bits_t z)
+{
+	for (; z >= 0x80; z = static_cast<bits_t>(z >> 7)) {
+		*p++ = static_cast<unsigned char>(z | 0x80);
+	}
+	*p++ = static_cast<unsigned char>(z);
+
+	return p;
+}
+
+template<class T>
+const unsigned char* packed_safelist<T>::get_varint(const unsigned char* p, bits_t& z)
+{
+	z = 0;
+	for (unsigned shift = 0;; shift += 7) {
+		const unsigned char byte = *p++;
+		z = static_cast<bits_t>(z | static_cast<bits_t>(static_cast<bits_t>(byte & 0x7f) << shift));
+		if (!(byte & 0x80)) {
+			return p;
+		}
+	}
+}
+
+template<class T>
+std::size_t packed_safelist<T>::encoded_size(const value_type* values, size_type count)
+{
+	std::size_t size = 0;
+	for (size_type i = 1; i < count; ++i) {
+		size += varint_size(delta(values[i - 1], values[i]));
+	}
+
+	return size;
+}
+
+template<class T>
+typename packed_safelist<T>::size_type packed_safelist<T>::decode(const chunk& c, value_type* values)
+{
+	const unsigned char* p = c.data;
+	values[0] = c.first;
+	for (size_type i = 1; i < c.count; ++i) {
+		bits_t z;
+		p = get_varint(p, z);
+		values[i] = add(values[i - 1], z);
+	}
+
+	return c.count;
+}
+
+// Encodes as many of the values into c as fit in limit bytes, but at least
+// one, and returns how many that was.
+template<class T>
+typename packed_safelist<T>::size_type packed_safelist<T>::fill(chunk& c, const value_type* values, size_type count, std::size_t limit)
+{
+	unsigned char* p = c.data;
+	size_type i = 1;
+	for (; i < count; ++i) {
+		const auto z = delta(values[i - 1], values[i]);
+		if (static_cast<std::size_t>(p - c.data) + varint_size(z) > limit) {
+			break;
+		}
+		p = put_varint(p, z);
+	}
+
+	c.first = values[0];
+	c.last = values[i - 1];
+	c.count = static_cast<unsigned short>(i);
+	c.bytes = static_cast<unsigned short>(p - c.data);
+	c.moved();
+
+	return i;
+}
+
+// Encodes the values over c, followed by as many new chunks as needed.
+// Values that do not fit are split about evenly, so that the chunks have
+// room to grow again.
+template<class T>
+void packed_safelist<T>::store(link_t c, const value_type* values, size_type count)
+{
+	for (;;) {
+		const auto size = encoded_size(values, count);
+		const auto limit = size <= chunk_bytes ? chunk_bytes : std::min(chunk_bytes, size / 2);
+		const auto stored = fill(*c, values, count, limit);
+		values += stored;
+		count -= stored;
+		if (!count) {
+			return;
+		}
+
+		c = insert_chunk(c);
+	}
+}
+
+// Assignment through an iterator. Iterators in the chunk are kept valid,
+// even if the chunk overflows and has to be split.
+template<class T>
+void packed_safelist<T>::assign_at(const link_t& c, size_type index, value_type value)
+{
+	if (!c || index >= c->count) {
+		throw std::range_error("Iterator does not point to an element");
+	}
+
+	value_type values[max_count];
+	const auto count = decode(*c, values);
+	if (values[index] == value) {
+		return;
+	}
+
+	// Only the encodings of the element and its successor change.
+	const auto at = [&]() { return index ? varint_size(delta(values[index - 1], values[index])) : 0; };
+	const auto after = [&]() { return index + 1 < count ? varint_size(delta(values[index], values[index + 1])) : 0; };
+	const auto old_at = at(), old_after = after();
+	values[index] = value;
+	const auto new_at = at(), new_after = after();
+
+	const auto size = c->bytes - old_at - old_after + new_at + new_after;
+	link_t spill;
+	if (size <= chunk_bytes) {
+		fill(*c, values, count, chunk_bytes);
+	} else if (encoded_size(values, index + 1) <= chunk_bytes) {
+		// Split right after the element.
+		spill = insert_chunk(c);
+		fill(*spill, values + index + 1, count - index - 1, chunk_bytes);
+		fill(*c, values, index + 1, chunk_bytes);
+	} else {
+		store(c, values, count);
+		spill = c->next;
+	}
+
+	c->edit = static_cast<unsigned short>(index);
+	c->shift_at = static_cast<short>(new_at - old_at);
+	c->shift_after = static_cast<short>(new_at + new_after - old_at - old_after);
+	c->edited = value;
+	if (spill) {
+		c->kept = c->count;
+		c->spill = spill;
+	}
+}
+
+template<class T>
+typename packed_safelist<T>::link_t packed_safelist<T>::insert_chunk(const link_t& after)
+{
+	auto c = std::make_shared<chunk>();
+	c->prev = after;
+	c->next = after->next;
+	after->next->prev = c;
+	after->next = c;
+
+	return c;
+}
+
+template<class T>
+void packed_safelist<T>::unlink_chunk(const link_t& c)
+{
+	auto prev = c->prev.lock();
+	prev->next = c->next;
+	c->next->prev = prev;
+	retire(*c);
+}
+
+// Leaves a chunk that is no longer in a list to the iterators that may
+// still hold it: it has no elements, and no links to keep others alive.
+template<class T>
+void packed_safelist<T>::retire(chunk& c)
+{
+	c.next.reset();
+	c.prev.reset();
+	c.count = 0;
+	c.bytes = 0;
+	c.moved();
+}
+
+template<class T>
+const std::size_t packed_safelist<T>::chunk_bytes;
+
+template<class T>
+const std::size_t packed_safelist<T>::max_count;
+
+template<class T>
+const unsigned short packed_safelist<T>::no_edit;
+
+template<class T>
+const unsigned short packed_safelist<T>::position::unknown;
+
+template<class T>
+void swap(packed_safelist<T>& a, packed_safelist<T>& b) noexcept
+{
+	a.swap(b);
+}
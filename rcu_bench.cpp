@@ -0,0 +1,120 @@
+#include "rcu_safelist.hpp"
+#include "safelist.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Readers repeatedly sum a list while a single writer rotates it; reports
+// completed list walks per second for a growing number of reader threads.
+
+const size_t list_size = 1000;
+const chrono::milliseconds duration(500);
+const chrono::microseconds write_interval(100);
+
+// Keeps the walks from being optimised away.
+atomic<uint64_t> sink(0);
+
+// Runs reader threads and one writer for a fixed time, returns walks/s.
+template<class Setup, class Read, class Write>
+double run(unsigned threads, Setup setup, Read read, Write write)
+{
+	atomic<bool> stop(false);
+	atomic<uint64_t> walks(0);
+
+	vector<thread> workers;
+	for (unsigned i = 0; i < threads; ++i) {
+		workers.emplace_back([&] {
+			auto state = setup();
+			uint64_t own = 0, sum = 0;
+			while (!stop.load(memory_order_relaxed)) {
+				sum += read(state);
+				++own;
+			}
+			walks += own;
+			sink += sum;
+		});
+	}
+
+	thread writer([&] {
+		while (!stop.load(memory_order_relaxed)) {
+			write();
+			this_thread::sleep_for(write_interval);
+		}
+	});
+
+	this_thread::sleep_for(duration);
+	stop = true;
+
+	for (auto& t : workers) {
+		t.join();
+	}
+	writer.join();
+
+	return walks / chrono::duration<double>(duration).count();
+}
+
+double bench_rcu(unsigned threads)
+{
+	rcu_safelist<uint64_t> l;
+	for (uint64_t i = 0; i < list_size; ++i) {
+		l.push_back(i);
+	}
+
+	uint64_t next = list_size;
+	return run(threads,
+		[&] { return l.make_reader(); },
+		[](rcu_safelist<uint64_t>::reader& r) {
+			uint64_t sum = 0;
+			r.for_each([&sum](uint64_t v) { sum += v; });
+			return sum;
+		},
+		[&] {
+			l.pop_front();
+			l.push_back(next++);
+		});
+}
+
+double bench_locked(unsigned threads)
+{
+	safelist<uint64_t> l;
+	mutex m;
+	for (uint64_t i = 0; i < list_size; ++i) {
+		l.push_back(i);
+	}
+
+	uint64_t next = list_size;
+	return run(threads,
+		[] { return 0; },
+		[&](int) {
+			lock_guard<mutex> lock(m);
+			uint64_t sum = 0;
+			for (auto v : l) {
+				sum += v;
+			}
+			return sum;
+		},
+		[&] {
+			lock_guard<mutex> lock(m);
+			l.pop_front();
+			l.push_back(next++);
+		});
+}
+
+int main(int argc, char** argv)
+{
+	const unsigned max_threads = argc > 1 ? atoi(argv[1]) : thread::hardware_concurrency();
+
+	cout << "readers\trcu_safelist walks/s\tlocked safelist walks/s" << endl;
+	for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+		cout << threads << '\t' << bench_rcu(threads) << '\t' << bench_locked(threads) << endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,515 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Read-mostly list in the style of RCU.
+//
+// Readers walk the list without taking locks or touching reference counts:
+// the only store a reader makes is to announce the epoch it is reading in,
+// and that goes to a slot of its own. Writers are serialised by a mutex and
+// publish every change with a single atomic store, so a reader sees each
+// link either before or after a change, never halfway.
+//
+// Unlinked nodes are not freed right away but retired, tagged with the
+// epoch in which they were unlinked. They are reclaimed once every active
+// reader has entered a later epoch, as such readers can no longer reach
+// them.
+//
+// Each reading thread needs its own reader, obtained from make_reader().
+// Elements may only be accessed inside a read_guard of that reader.
+// Readers must be destroyed before the list is.
+template<class T>
+class rcu_safelist
+{
+	public:
+		typedef T value_type;
+		typedef std::size_t size_type;
+		typedef const T& const_reference;
+
+		class reader;
+		class read_guard;
+		class const_iterator;
+
+		rcu_safelist();
+		rcu_safelist(const rcu_safelist&) = delete;
+		rcu_safelist& operator=(const rcu_safelist&) = delete;
+		~rcu_safelist();
+
+		reader make_reader();
+
+		// Writer operations
+		void push_front(const value_type& value);
+		void push_back(const value_type& value);
+		void pop_front();
+
+		template<class UnaryPredicate>
+		size_type remove_if(UnaryPredicate pred);
+		size_type remove(const value_type& value);
+
+		// Replaces the whole contents at once: readers see either the old
+		// or the new list.
+		template<class InputIt>
+		void assign(InputIt first, InputIt last);
+		void clear();
+
+		size_type size() const;
+		bool empty() const { return size() == 0; };
+
+		// Number of unlinked nodes that still wait for readers to move on.
+		size_type retired() const;
+
+		// Frees the retired nodes that no reader can see anymore. Writer
+		// operations do this on their own.
+		void reclaim();
+
+	private:
+		struct node
+		{
+			const value_type value;
+			std::atomic<node*> next;
+
+			node(const value_type& value, node* next): value(value), next(next) {};
+		};
+
+		// The epoch a reader is in, or 0 when it is not reading. Padded so
+		// that readers do not share cache lines.
+		struct slot
+		{
+			std::atomic<std::uint64_t> epoch;
+			bool used;
+			char padding[64];
+
+			slot(): epoch(0), used(true) {};
+		};
+
+		struct retired_node
+		{
+			node* item;
+			std::uint64_t epoch;
+		};
+
+		std::atomic<node*> head;
+		node* tail;
+		std::atomic<size_type> m_size;
+
+		std::atomic<std::uint64_t> epoch;
+
+		mutable std::mutex writer;
+		std::vector<std::unique_ptr<slot>> slots;
+		std::vector<retired_node> retired_nodes;
+
+		// These expect the writer mutex to be held.
+		void replace(node* chain, node* chainTail, size_type count);
+		std::uint64_t next_epoch();
+		void reclaim_locked();
+
+		static void free_chain(node* chain);
+};
+
+template<class T>
+class rcu_safelist<T>::const_iterator
+{
+	public:
+		friend read_guard;
+
+		typedef std::ptrdiff_t difference_type;
+		typedef const T value_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+		typedef std::forward_iterator_tag iterator_category;
+
+		const_iterator(): item(nullptr) {};
+
+		const_iterator& operator++()
+		{
+			item = item->next.load(std::memory_order_acquire);
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			const_iterator copy = *this;
+			++(*this);
+
+			return copy;
+		}
+
+		reference operator*() const { return item->value; };
+		pointer operator->() const { return &item->value; };
+		bool operator==(const const_iterator& other) const { return item == other.item; };
+		bool operator!=(const const_iterator& other) const { return item != other.item; };
+
+	private:
+		const node* item;
+
+		const_iterator(const node* item): item(item) {};
+};
+
+// A reading thread's handle on the list. Not thread safe itself.
+template<class T>
+class rcu_safelist<T>::reader
+{
+	public:
+		friend rcu_safelist<T>;
+		friend read_guard;
+
+		reader(reader&& other);
+		reader(const reader&) = delete;
+		reader& operator=(const reader&) = delete;
+		~reader();
+
+		read_guard lock();
+
+		template<class F>
+		void for_each(F f);
+
+	private:
+		rcu_safelist* list;
+		slot* own;
+		unsigned depth;
+
+		reader(rcu_safelist* list, slot* own): list(list), own(own), depth(0) {};
+
+		void enter();
+		void leave();
+};
+
+// Keeps the elements reachable from the list alive while it exists.
+template<class T>
+class rcu_safelist<T>::read_guard
+{
+	public:
+		friend reader;
+
+		read_guard(read_guard&& other): owner(other.owner) { other.owner = nullptr; };
+		read_guard(const read_guard&) = delete;
+		read_guard& operator=(const read_guard&) = delete;
+		~read_guard();
+
+		const_iterator begin() const;
+		const_iterator end() const { return const_iterator(); };
+
+	private:
+		reader* owner;
+
+		explicit read_guard(reader* owner);
+};
+
+template<class T>
+rcu_safelist<T>::rcu_safelist(): head(nullptr), tail(nullptr), m_size(0), epoch(1)
+{
+}
+
+template<class T>
+rcu_safelist<T>::~rcu_safelist()
+{
+	free_chain(head.load(std::memory_order_relaxed));
+	for (auto& r : retired_nodes) {
+		delete r.item;
+	}
+}
+
+template<class T>
+typename rcu_safelist<T>::reader rcu_safelist<T>::make_reader()
+{
+	std::lock_guard<std::mutex> lock(writer);
+
+	for (auto& s : slots) {
+		if (!s->used) {
+			s->used = true;
+			return reader(this, s.get());
+		}
+	}
+
+	slots.emplace_back(new slot());
+	return reader(this, slots.back().get());
+}
+
+template<class T>
+void rcu_safelist<T>::push_front(const value_type& value)
+{
+	std::lock_guard<std::mutex> lock(writer);
+
+	auto item = new node(value, head.load(std::memory_order_relaxed));
+	if (!tail) {
+		tail = item;
+	}
+
+	head.store(item, std::memory_order_release);
+	++m_size;
+}
+
+template<class T>
+void rcu_safelist<T>::push_back(const value_type& value)
+{
+	std::lock_guard<std::mutex> lock(writer);
+
+	auto item = new node(value, nullptr);
+	if (tail) {
+		tail->next.store(item, std::memory_order_release);
+	} else {
+		head.store(item, std::memory_order_release);
+	}
+
+	tail = item;
+	++m_size;
+}
+
+template<class T>
+void rcu_safelist<T>::pop_front()
+{
+	std::lock_guard<std::mutex> lock(writer);
+
+	auto item = head.load(std::memory_order_relaxed);
+	if (!item) {
+		return;
+	}
+
+	head.store(item->next.load(std::memory_order_relaxed), std::memory_order_release);
+	if (tail == item) {
+		tail = nullptr;
+	}
+	--m_size;
+
+	retired_nodes.push_back({item, next_epoch()});
+	reclaim_locked();
+}
+
+template<class T>
+template<class UnaryPredicate>
+typename rcu_safelist<T>::size_type rcu_safelist<T>::remove_if(UnaryPredicate pred)
+{
+	std::lock_guard<std::mutex> lock(writer);
+
+	std::vector<node*> removed;
+	std::atomic<node*>* link = &head;
+	node* prev = nullptr;
+
+	while (auto item = link->load(std::memory_order_relaxed)) {
+		if (pred(item->value)) {
+			link->store(item->next.load(std::memory_order_relaxed), std::memory_order_release);
+			if (tail == item) {
+				tail = prev;
+			}
+			removed.push_back(item);
+		} else {
+			prev = item;
+			link = &item->next;
+		}
+	}
+
+	if (!removed.empty()) {
+		const auto tag = next_epoch();
+		for (auto item : removed) {
+			retired_nodes.push_back({item, tag});
+		}
+
+		m_size -= removed.size();
+		reclaim_locked();
+	}
+
+	return removed.size();
+}
+
+template<class T>
+typename rcu_safelist<T>::size_type rcu_safelist<T>::remove(const value_type& value)
+{
+	return remove_if([&value](const value_type& v) { return v == value; });
+}
+
+template<class T>
+template<class InputIt>
+void rcu_safelist<T>::assign(InputIt first, InputIt last)
+{
+	// Build the replacement privately before taking the lock.
+	node* chain = nullptr;
+	node* chainTail = nullptr;
+	size_type count = 0;
+	for (; first != last; ++first, ++count) {
+		auto item = new node(*first, nullptr);
+		if (chainTail) {
+			chainTail->next.store(item, std::memory_order_relaxed);
+		} else {
+			chain = item;
+		}
+		chainTail = item;
+	}
+
+	std::lock_guard<std::mutex> lock(writer);
+	replace(chain, chainTail, count);
+}
+
+template<class T>
+void rcu_safelist<T>::clear()
+{
+	std::lock_guard<std::mutex> lock(writer);
+	replace(nullptr, nullptr, 0);
+}
+
+template<class T>
+typename rcu_safelist<T>::size_type rcu_safelist<T>::size() const
+{
+	return m_size.load(std::memory_order_relaxed);
+}
+
+template<class T>
+typename rcu_safelist<T>::size_type rcu_safelist<T>::retired() const
+{
+	std::lock_guard<std::mutex> lock(writer);
+	return retired_nodes.size();
+}
+
+template<class T>
+void rcu_safelist<T>::reclaim()
+{
+	std::lock_guard<std::mutex> lock(writer);
+	reclaim_locked();
+}
+
+// Publishes a new chain and retires the old one.
+template<class T>
+void rcu_safelist<T>::replace(node* chain, node* chainTail, size_type count)
+{
+	auto old = head.exchange(chain, std::memory_order_acq_rel);
+	tail = chainTail;
+	m_size = count;
+
+	if (old) {
+		const auto tag = next_epoch();
+		for (; old; old = old->next.load(std::memory_order_relaxed)) {
+			retired_nodes.push_back({old, tag});
+		}
+	}
+
+	reclaim_locked();
+}
+
+// Ends the current epoch and returns it, to tag the nodes just unlinked.
+template<class T>
+std::uint64_t rcu_safelist<T>::next_epoch()
+{
+	// Pairs with the fence in reader::enter(): either the scan in
+	// reclaim_locked() sees the reader's epoch, or the reader sees the
+	// unlinked state.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	return epoch.fetch_add(1, std::memory_order_acq_rel);
+}
+
+template<class T>
+void rcu_safelist<T>::reclaim_locked()
+{
+	if (retired_nodes.empty()) {
+		return;
+	}
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Readers in an epoch after a node's tag started after it was unlinked.
+	auto oldest = epoch.load(std::memory_order_acquire);
+	for (auto& s : slots) {
+		const auto e = s->epoch.load(std::memory_order_acquire);
+		if (e != 0 && e < oldest) {
+			oldest = e;
+		}
+	}
+
+	auto keep = retired_nodes.begin();
+	for (auto& r : retired_nodes) {
+		if (r.epoch < oldest) {
+			delete r.item;
+		} else {
+			*keep++ = r;
+		}
+	}
+
+	retired_nodes.erase(keep, retired_nodes.end());
+}
+
+template<class T>
+void rcu_safelist<T>::free_chain(node* chain)
+{
+	while (chain) {
+		auto next = chain->next.load(std::memory_order_relaxed);
+		delete chain;
+		chain = next;
+	}
+}
+
+// Reader functions
+template<class T>
+rcu_safelist<T>::reader::reader(reader&& other): list(other.list), own(other.own), depth(other.depth)
+{
+	other.list = nullptr;
+	other.own = nullptr;
+}
+
+template<class T>
+rcu_safelist<T>::reader::~reader()
+{
+	if (own) {
+		std::lock_guard<std::mutex> lock(list->writer);
+		own->epoch.store(0, std::memory_order_release);
+		own->used = false;
+	}
+}
+
+template<class T>
+typename rcu_safelist<T>::read_guard rcu_safelist<T>::reader::lock()
+{
+	return read_guard(this);
+}
+
+template<class T>
+template<class F>
+void rcu_safelist<T>::reader::for_each(F f)
+{
+	read_guard guard(this);
+	for (auto& value : guard) {
+		f(value);
+	}
+}
+
+template<class T>
+void rcu_safelist<T>::reader::enter()
+{
+	if (depth++ == 0) {
+		own->epoch.store(list->epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+}
+
+template<class T>
+void rcu_safelist<T>::reader::leave()
+{
+	if (--depth == 0) {
+		own->epoch.store(0, std::memory_order_release);
+	}
+}
+
+// Read guard functions
+template<class T>
+rcu_safelist<T>::read_guard::read_guard(reader* owner): owner(owner)
+{
+	owner->enter();
+}
+
+template<class T>
+rcu_safelist<T>::read_guard::~read_guard()
+{
+	if (owner) {
+		owner->leave();
+	}
+}
+
+template<class T>
+typename rcu_safelist<T>::const_iterator rcu_safelist<T>::read_guard::begin() const
+{
+	return const_iterator(owner->list->head.load(std::memory_order_acquire));
+}
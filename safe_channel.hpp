@@ -0,0 +1,462 @@
+#pragma once
+
+#if __cplusplus < 202002L
+#error "safe_channel.hpp needs C++20 coroutines"
+#endif
+
+#include "intrusive_safelist.hpp"
+#include "safelist.hpp"
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <optional>
+#include <utility>
+
+// Channels for coroutines, queueing their elements in a safelist, and the
+// single-threaded executor that runs those coroutines.
+//
+//     local_executor::task consume(safe_channel<int>& ch)
+//     {
+//         while (auto v = co_await ch.pop()) {
+//             ...
+//         }
+//     }
+//
+//     local_executor ex;
+//     safe_channel<int> ch(ex);
+//     ex.spawn(consume(ch));
+//     ch.push_back(1);
+//     ch.close();
+//     ex.run();
+//
+// A coroutine waiting on a channel is linked into it through its awaiter,
+// so nothing is polled: pushing hands the element to the first waiting
+// coroutine and schedules it on the executor. Waiting coroutines and the
+// channel may be destroyed in either order.
+
+// Runs coroutines on the calling thread, in the order they become ready.
+class local_executor
+{
+	public:
+		class task;
+
+		local_executor() = default;
+		local_executor(const local_executor&) = delete;
+		local_executor& operator=(const local_executor&) = delete;
+
+		// Destroys the tasks that have not finished.
+		~local_executor();
+
+		// Schedules a task to start on the next run().
+		void spawn(task t);
+
+		// Schedules a suspended coroutine to be resumed.
+		void post(std::coroutine_handle<> h) { m_ready.push_back(h); };
+
+		// Resumes coroutines until none is ready, and returns how many
+		// resumptions that took. An exception escaping a task is rethrown
+		// from here.
+		std::size_t run();
+
+		// co_await ex.yield() lets the other ready coroutines go first.
+		struct yield_awaiter
+		{
+			local_executor* executor;
+
+			bool await_ready() const noexcept { return false; };
+			void await_suspend(std::coroutine_handle<> h) { executor->post(h); };
+			void await_resume() const noexcept {};
+		};
+
+		yield_awaiter yield() { return yield_awaiter{this}; };
+
+	private:
+		struct task_promise;
+
+		std::deque<std::coroutine_handle<>> m_ready;
+		intrusive_safelist<task_promise> m_tasks;
+		std::exception_ptr m_failure;
+};
+
+// Fire-and-forget coroutine, started by local_executor::spawn().
+class local_executor::task
+{
+	public:
+		typedef task_promise promise_type;
+
+		task(task&& other) noexcept: handle(std::exchange(other.handle, nullptr)) {};
+		task(const task&) = delete;
+		task& operator=(const task&) = delete;
+
+		// A task that was never spawned is destroyed along with it.
+		~task()
+		{
+			if (handle) {
+				handle.destroy();
+			}
+		};
+
+	private:
+		friend local_executor;
+
+		std::coroutine_handle<promise_type> handle;
+
+		explicit task(std::coroutine_handle<promise_type> handle): handle(handle) {};
+};
+
+// The executor keeps its unfinished tasks on a list, which they leave when
+// their frame is destroyed.
+struct local_executor::task_promise : intrusive_hook<>
+{
+	local_executor* executor = nullptr;
+
+	task get_return_object() { return task(std::coroutine_handle<task_promise>::from_promise(*this)); };
+	std::suspend_always initial_suspend() const noexcept { return {}; };
+	std::suspend_never final_suspend() const noexcept { return {}; };
+	void return_void() const noexcept {};
+
+	void unhandled_exception() noexcept
+	{
+		if (!executor->m_failure) {
+			executor->m_failure = std::current_exception();
+		}
+	};
+};
+
+inline local_executor::~local_executor()
+{
+	m_ready.clear();
+	while (!m_tasks.empty()) {
+		std::coroutine_handle<task_promise>::from_promise(m_tasks.front()).destroy();
+	}
+}
+
+inline void local_executor::spawn(task t)
+{
+	auto h = std::exchange(t.handle, nullptr);
+	h.promise().executor = this;
+	m_tasks.push_back(h.promise());
+	post(h);
+}
+
+inline std::size_t local_executor::run()
+{
+	std::size_t resumed = 0;
+	while (!m_ready.empty()) {
+		auto h = m_ready.front();
+		m_ready.pop_front();
+		h.resume();
+		++resumed;
+
+		if (m_failure) {
+			std::rethrow_exception(std::exchange(m_failure, nullptr));
+		}
+	}
+
+	return resumed;
+}
+
+template<class T>
+class safe_channel
+{
+	private:
+		struct receiver;
+		struct sender;
+
+	public:
+		typedef T value_type;
+		typedef std::size_t size_type;
+
+		class pop_awaiter;
+		class pop_many_awaiter;
+		class push_awaiter;
+
+		// A capacity of 0 leaves the channel unbounded.
+		explicit safe_channel(local_executor& executor, size_type capacity = 0):
+			m_executor(executor), m_capacity(capacity), m_closed(false) {};
+		safe_channel(const safe_channel&) = delete;
+		safe_channel& operator=(const safe_channel&) = delete;
+
+		// Closes the channel, so that nothing waits on it forever.
+		~safe_channel() { close(); };
+
+		// Adds an element without waiting. Fails if the channel is closed
+		// or full.
+		bool push_back(value_type value) { return offer(value); };
+
+		// Adds an element, waiting for room if the channel is bounded.
+		// Yields false if the channel is closed first.
+		push_awaiter push(value_type value) { return push_awaiter(this, std::move(value)); };
+
+		// Waits for an element. Yields nothing once the channel is closed
+		// and drained.
+		pop_awaiter pop() { return pop_awaiter(this); };
+
+		// Waits for an element, then takes up to count of them as one run
+		// of nodes. Elements pushed while the coroutine waits to be resumed
+		// go straight into the run. Yields an empty list once the channel is
+		// closed and drained.
+		pop_many_awaiter pop_many(size_type count) { return pop_many_awaiter(this, count); };
+
+		// Wakes all waiting coroutines. What is in the channel can still be
+		// popped, but nothing can be pushed.
+		void close();
+		bool closed() const { return m_closed; };
+
+		size_type size() const { return m_items.size(); };
+		bool empty() const { return m_items.empty(); };
+		size_type capacity() const { return m_capacity; };
+
+	private:
+		// A coroutine waiting to pop. It is on m_receivers until something
+		// is handed to it, and on m_filling while its batch has room left
+		// and it has not run yet.
+		struct receiver : intrusive_hook<>
+		{
+			safe_channel* channel;
+			size_type limit;
+			bool suspended = false;
+			std::coroutine_handle<> handle;
+			safelist<value_type> batch;
+
+			receiver(safe_channel* channel, size_type limit): channel(channel), limit(limit) {};
+
+			bool ready() const { return !channel->m_items.empty() || channel->m_closed; };
+			void suspend(std::coroutine_handle<> h);
+		};
+
+		// A coroutine waiting for room to push.
+		struct sender : intrusive_hook<>
+		{
+			safe_channel* channel;
+			value_type value;
+			bool accepted = false;
+			std::coroutine_handle<> handle;
+
+			sender(safe_channel* channel, value_type&& value): channel(channel), value(std::move(value)) {};
+		};
+
+		local_executor& m_executor;
+		size_type m_capacity;
+		bool m_closed;
+		safelist<value_type> m_items;
+		intrusive_safelist<receiver> m_receivers;
+		intrusive_safelist<receiver> m_filling;
+		intrusive_safelist<sender> m_senders;
+
+		bool full() const { return m_capacity && m_items.size() >= m_capacity; };
+
+		// Both only move value if they succeed.
+		bool offer(value_type& value);
+		bool deliver(value_type& value);
+
+		void take(safelist<value_type>& batch, size_type count);
+		void admit();
+};
+
+template<class T>
+class safe_channel<T>::pop_awaiter : receiver
+{
+	public:
+		friend safe_channel<T>;
+
+		bool await_ready() const { return this->ready(); };
+		void await_suspend(std::coroutine_handle<> h) { this->suspend(h); };
+		std::optional<value_type> await_resume();
+
+	private:
+		explicit pop_awaiter(safe_channel* channel): receiver(channel, 1) {};
+};
+
+template<class T>
+class safe_channel<T>::pop_many_awaiter : receiver
+{
+	public:
+		friend safe_channel<T>;
+
+		bool await_ready() const { return this->ready(); };
+		void await_suspend(std::coroutine_handle<> h) { this->suspend(h); };
+		safelist<value_type> await_resume();
+
+	private:
+		pop_many_awaiter(safe_channel* channel, size_type count): receiver(channel, count ? count : 1) {};
+};
+
+template<class T>
+class safe_channel<T>::push_awaiter : sender
+{
+	public:
+		friend safe_channel<T>;
+
+		bool await_ready();
+		void await_suspend(std::coroutine_handle<> h);
+		bool await_resume() const { return this->accepted; };
+
+	private:
+		push_awaiter(safe_channel* channel, value_type&& value): sender(channel, std::move(value)) {};
+};
+
+// Awaiters
+template<class T>
+void safe_channel<T>::receiver::suspend(std::coroutine_handle<> h)
+{
+	handle = h;
+	suspended = true;
+	channel->m_receivers.push_back(*this);
+}
+
+// A resumed coroutine only looks at its own batch, as the channel may be
+// gone by then.
+template<class T>
+std::optional<T> safe_channel<T>::pop_awaiter::await_resume()
+{
+	if (this->suspended) {
+		if (this->batch.empty()) {
+			return std::nullopt;
+		}
+		return std::move(this->batch.front());
+	}
+
+	auto& items = this->channel->m_items;
+	if (items.empty()) {
+		return std::nullopt;
+	}
+
+	std::optional<value_type> value(std::move(items.front()));
+	items.pop_front();
+	this->channel->admit();
+
+	return value;
+}
+
+template<class T>
+safelist<T> safe_channel<T>::pop_many_awaiter::await_resume()
+{
+	if (this->suspended) {
+		this->unlink();
+	} else {
+		this->channel->take(this->batch, this->limit);
+	}
+
+	return std::move(this->batch);
+}
+
+template<class T>
+bool safe_channel<T>::push_awaiter::await_ready()
+{
+	this->accepted = this->channel->offer(this->value);
+
+	return this->accepted || this->channel->m_closed;
+}
+
+template<class T>
+void safe_channel<T>::push_awaiter::await_suspend(std::coroutine_handle<> h)
+{
+	this->handle = h;
+	this->channel->m_senders.push_back(*this);
+}
+
+// Channel
+template<class T>
+void safe_channel<T>::close()
+{
+	m_closed = true;
+
+	while (!m_receivers.empty()) {
+		auto& r = m_receivers.front();
+		m_receivers.pop_front();
+		m_executor.post(r.handle);
+	}
+	m_filling.clear();
+
+	while (!m_senders.empty()) {
+		auto& s = m_senders.front();
+		m_senders.pop_front();
+		m_executor.post(s.handle);
+	}
+}
+
+template<class T>
+bool safe_channel<T>::offer(value_type& value)
+{
+	if (m_closed) {
+		return false;
+	}
+	if (deliver(value)) {
+		return true;
+	}
+	if (full()) {
+		return false;
+	}
+
+	m_items.emplace_back(std::move(value));
+	return true;
+}
+
+// Hands value to a waiting coroutine, if there is one. Elements only
+// queue up in m_items while no coroutine waits.
+template<class T>
+bool safe_channel<T>::deliver(value_type& value)
+{
+	if (!m_filling.empty()) {
+		auto& r = m_filling.front();
+		r.batch.emplace_back(std::move(value));
+		if (r.batch.size() >= r.limit) {
+			m_filling.pop_front();
+		}
+		return true;
+	}
+
+	// The receiver only leaves m_receivers once it holds the value and is
+	// posted, so that running out of memory cannot strand it there.
+	if (!m_receivers.empty()) {
+		auto& r = m_receivers.front();
+		r.batch.emplace_back(std::move(value));
+		try {
+			m_executor.post(r.handle);
+		} catch (...) {
+			value = std::move(r.batch.back());
+			r.batch.pop_back();
+			throw;
+		}
+
+		m_receivers.pop_front();
+		if (r.batch.size() < r.limit) {
+			m_filling.push_back(r);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+// Moves the first count elements into batch, which is empty, by cutting
+// the queue rather than moving them one at a time.
+template<class T>
+void safe_channel<T>::take(safelist<value_type>& batch, size_type count)
+{
+	if (count >= m_items.size()) {
+		batch.swap(m_items);
+	} else {
+		auto rest = m_items.split_at(std::next(m_items.begin(), count));
+		batch.swap(m_items);
+		m_items.swap(rest);
+	}
+
+	admit();
+}
+
+// Lets waiting senders fill up the room made by popping.
+template<class T>
+void safe_channel<T>::admit()
+{
+	while (!m_senders.empty() && !full()) {
+		auto& s = m_senders.front();
+		m_senders.pop_front();
+		m_items.emplace_back(std::move(s.value));
+		s.accepted = true;
+		m_executor.post(s.handle);
+	}
+}
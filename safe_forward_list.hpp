@@ -0,0 +1,916 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Memory-safe replacement for std::forward_list.
+//
+// Like safelist, nodes are owned through shared_ptrs and iterators hold
+// weak_ptrs, so an iterator to an erased element expires instead of
+// dangling. Being singly linked makes the nodes a lot cheaper: a node is a
+// single allocation holding the control block, the next link and the value,
+// and there is no prev link to keep up to date.
+//
+// Using an expired iterator, end() or before_begin() where an element is
+// needed throws std::range_error.
+template<class T>
+class safe_forward_list
+{
+	public:
+		typedef T value_type;
+		typedef std::size_t size_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef T& reference;
+		typedef const T& const_reference;
+
+		class iterator;
+		class const_iterator;
+
+		template<typename Iterator>
+			using is_compatible_iterator = std::is_assignable<value_type&, decltype(*(std::declval<Iterator>()))>;
+
+		template<typename Iterator>
+			using if_is_compatible_iterator = std::enable_if<is_compatible_iterator<Iterator>::value>;
+
+		// Constructors
+		safe_forward_list() noexcept {};
+		explicit safe_forward_list(size_type count);
+		safe_forward_list(size_type count, const value_type& value);
+		template<class InputIt,
+			typename = typename if_is_compatible_iterator<InputIt>::type>
+				safe_forward_list(InputIt first, InputIt last);
+		safe_forward_list(std::initializer_list<value_type> ilist);
+		safe_forward_list(const safe_forward_list& other);
+		safe_forward_list(safe_forward_list&& other) noexcept;
+
+		~safe_forward_list();
+
+		safe_forward_list& operator=(const safe_forward_list& other);
+		safe_forward_list& operator=(safe_forward_list&& other) noexcept;
+
+		// Assignment reuses the existing nodes.
+		void assign(size_type count, const value_type& value);
+		template<class InputIt,
+			typename = typename if_is_compatible_iterator<InputIt>::type>
+		void assign(InputIt first, InputIt last);
+		void assign(std::initializer_list<value_type> ilist);
+
+		void swap(safe_forward_list& other) noexcept;
+
+		// Element access
+		value_type& front();
+		const value_type& front() const;
+
+		// Iterators
+		iterator before_begin();
+		const_iterator before_begin() const;
+		const_iterator cbefore_begin() const { return before_begin(); };
+		iterator begin();
+		const_iterator begin() const;
+		const_iterator cbegin() const { return begin(); };
+		iterator end() { return iterator(); };
+		const_iterator end() const { return const_iterator(); };
+		const_iterator cend() const { return end(); };
+
+		// Capacity
+		bool empty() const { return !m_head || !m_head->next; };
+		size_type max_size() const { return std::numeric_limits<difference_type>::max(); };
+
+		// Modifiers
+		void clear();
+
+		iterator insert_after(const_iterator pos, const value_type& value);
+		iterator insert_after(const_iterator pos, value_type&& value);
+		iterator insert_after(const_iterator pos, size_type count, const value_type& value);
+		template<class InputIt,
+			typename = typename if_is_compatible_iterator<InputIt>::type>
+		iterator insert_after(const_iterator pos, InputIt first, InputIt last);
+		iterator insert_after(const_iterator pos, std::initializer_list<value_type> ilist);
+		template<class... Args>
+		iterator emplace_after(const_iterator pos, Args&&... args);
+
+		iterator erase_after(const_iterator pos);
+		iterator erase_after(const_iterator first, const_iterator last);
+
+		void push_front(const value_type& value);
+		void push_front(value_type&& value);
+		template<class... Args>
+		void emplace_front(Args&&... args);
+		void pop_front();
+
+		void resize(size_type count);
+		void resize(size_type count, const value_type& value);
+
+		// Operations
+		template<class Compare = std::less<value_type>>
+		void merge(safe_forward_list& other, Compare comp = Compare());
+
+		void splice_after(const_iterator pos, safe_forward_list& other);
+		void splice_after(const_iterator pos, safe_forward_list& other, const_iterator it);
+		void splice_after(const_iterator pos, safe_forward_list& other, const_iterator first, const_iterator last);
+
+		void remove(const value_type& value);
+		template<class UnaryPredicate>
+		void remove_if(UnaryPredicate pred);
+
+		void reverse() noexcept;
+
+		template<class BinaryPredicate = std::equal_to<value_type>>
+		void unique(BinaryPredicate pred = BinaryPredicate());
+
+		template<class Compare = std::less<value_type>>
+		void sort(Compare comp = Compare());
+
+		// Comparisons
+		bool operator==(const safe_forward_list& other) const;
+		bool operator!=(const safe_forward_list& other) const;
+		bool operator<(const safe_forward_list& other) const;
+		bool operator<=(const safe_forward_list& other) const;
+		bool operator>(const safe_forward_list& other) const;
+		bool operator>=(const safe_forward_list& other) const;
+
+	private:
+		struct node_base;
+		struct node;
+		typedef std::shared_ptr<node_base> link_t;
+
+		// Precedes the first element, so that everything can be done
+		// "after" some node. Created on first use.
+		link_t m_head;
+
+		const link_t& head();
+
+		// The node an iterator is at, or an exception if it has none.
+		static link_t node_at(const std::weak_ptr<node_base>& pos);
+		static value_type& value_of(const link_t& n) { return static_cast<node&>(*n).value; };
+
+		template<class... Args>
+		static link_t make_node(Args&&... args);
+		static void release_chain(link_t chain);
+
+		template<class Compare>
+		static void merge_chains(link_t& a, link_t& b, Compare& comp);
+};
+
+template<class T>
+struct safe_forward_list<T>::node_base
+{
+	link_t next;
+};
+
+template<class T>
+struct safe_forward_list<T>::node : node_base
+{
+	value_type value;
+
+	template<class... Args>
+	explicit node(Args&&... args): value(std::forward<Args>(args)...)
+	{
+	}
+};
+
+template<class T>
+class safe_forward_list<T>::iterator
+{
+	public:
+		friend safe_forward_list<T>;
+		friend safe_forward_list<T>::const_iterator;
+
+		typedef std::ptrdiff_t difference_type;
+		typedef T value_type;
+		typedef T* pointer;
+		typedef T& reference;
+		typedef std::forward_iterator_tag iterator_category;
+
+		iterator() = default;
+
+		iterator& operator++();
+		iterator operator++(int);
+
+		reference operator*() const;
+		pointer operator->() const { return &**this; };
+		bool operator==(const iterator& other) const;
+		bool operator!=(const iterator& other) const { return !(*this == other); };
+
+	private:
+		std::weak_ptr<node_base> item;
+		// Set for before_begin(), as the head node has no value.
+		bool before_begin = false;
+
+		iterator(const link_t& item, bool before_begin = false): item(item), before_begin(before_begin) {};
+		iterator(const const_iterator& it): item(it.item), before_begin(it.before_begin) {};
+};
+
+template<class T>
+class safe_forward_list<T>::const_iterator
+{
+	public:
+		friend safe_forward_list<T>;
+		friend safe_forward_list<T>::iterator;
+
+		typedef std::ptrdiff_t difference_type;
+		typedef const T value_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+		typedef std::forward_iterator_tag iterator_category;
+
+		const_iterator() = default;
+		const_iterator(const iterator& it): item(it.item), before_begin(it.before_begin) {};
+
+		const_iterator& operator++();
+		const_iterator operator++(int);
+
+		reference operator*() const;
+		pointer operator->() const { return &**this; };
+		bool operator==(const const_iterator& other) const;
+		bool operator!=(const const_iterator& other) const { return !(*this == other); };
+
+	private:
+		std::weak_ptr<node_base> item;
+		bool before_begin = false;
+
+		const_iterator(const link_t& item, bool before_begin = false): item(item), before_begin(before_begin) {};
+};
+
+// Constructors
+template<class T>
+safe_forward_list<T>::safe_forward_list(size_type count)
+{
+	resize(count);
+}
+
+template<class T>
+safe_forward_list<T>::safe_forward_list(size_type count, const value_type& value)
+{
+	insert_after(before_begin(), count, value);
+}
+
+template<class T>
+template<class InputIt, typename>
+safe_forward_list<T>::safe_forward_list(InputIt first, InputIt last)
+{
+	insert_after(before_begin(), first, last);
+}
+
+template<class T>
+safe_forward_list<T>::safe_forward_list(std::initializer_list<value_type> ilist): safe_forward_list(ilist.begin(), ilist.end())
+{
+}
+
+template<class T>
+safe_forward_list<T>::safe_forward_list(const safe_forward_list& other): safe_forward_list(other.begin(), other.end())
+{
+}
+
+template<class T>
+safe_forward_list<T>::safe_forward_list(safe_forward_list&& other) noexcept: m_head(std::move(other.m_head))
+{
+}
+
+template<class T>
+safe_forward_list<T>::~safe_forward_list()
+{
+	if (m_head) {
+		release_chain(std::move(m_head->next));
+	}
+}
+
+template<class T>
+safe_forward_list<T>& safe_forward_list<T>::operator=(const safe_forward_list& other)
+{
+	if (&other != this) {
+		assign(other.begin(), other.end());
+	}
+
+	return *this;
+}
+
+template<class T>
+safe_forward_list<T>& safe_forward_list<T>::operator=(safe_forward_list&& other) noexcept
+{
+	if (&other != this) {
+		clear();
+		m_head = std::move(other.m_head);
+	}
+
+	return *this;
+}
+
+template<class T>
+void safe_forward_list<T>::assign(size_type count, const value_type& value)
+{
+	auto prev = before_begin();
+	for (auto it = begin(); it != end() && count > 0; ++it, ++prev, --count) {
+		*it = value;
+	}
+
+	if (count > 0) {
+		insert_after(prev, count, value);
+	} else {
+		erase_after(prev, end());
+	}
+}
+
+template<class T>
+template<class InputIt, typename>
+void safe_forward_list<T>::assign(InputIt first, InputIt last)
+{
+	auto prev = before_begin();
+	for (auto it = begin(); it != end() && first != last; ++it, ++prev, ++first) {
+		*it = *first;
+	}
+
+	if (first != last) {
+		insert_after(prev, first, last);
+	} else {
+		erase_after(prev, end());
+	}
+}
+
+template<class T>
+void safe_forward_list<T>::assign(std::initializer_list<value_type> ilist)
+{
+	assign(ilist.begin(), ilist.end());
+}
+
+template<class T>
+void safe_forward_list<T>::swap(safe_forward_list& other) noexcept
+{
+	std::swap(m_head, other.m_head);
+}
+
+template<class T>
+void swap(safe_forward_list<T>& a, safe_forward_list<T>& b)
+{
+	a.swap(b);
+}
+
+// Element access
+template<class T>
+T& safe_forward_list<T>::front()
+{
+	return *begin();
+}
+
+template<class T>
+const T& safe_forward_list<T>::front() const
+{
+	return *begin();
+}
+
+// Iterator creation
+template<class T>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::before_begin()
+{
+	return iterator(head(), true);
+}
+
+template<class T>
+typename safe_forward_list<T>::const_iterator safe_forward_list<T>::before_begin() const
+{
+	return m_head ? const_iterator(m_head, true) : const_iterator();
+}
+
+template<class T>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::begin()
+{
+	return m_head ? iterator(m_head->next) : iterator();
+}
+
+template<class T>
+typename safe_forward_list<T>::const_iterator safe_forward_list<T>::begin() const
+{
+	return m_head ? const_iterator(m_head->next) : const_iterator();
+}
+
+// Modifiers
+template<class T>
+void safe_forward_list<T>::clear()
+{
+	if (m_head) {
+		release_chain(std::move(m_head->next));
+	}
+}
+
+template<class T>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::insert_after(const_iterator pos, const value_type& value)
+{
+	return emplace_after(pos, value);
+}
+
+template<class T>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::insert_after(const_iterator pos, value_type&& value)
+{
+	return emplace_after(pos, std::move(value));
+}
+
+template<class T>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::insert_after(const_iterator pos, size_type count, const value_type& value)
+{
+	iterator last = pos;
+	for (; count > 0; --count) {
+		last = emplace_after(last, value);
+	}
+
+	return last;
+}
+
+template<class T>
+template<class InputIt, typename>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::insert_after(const_iterator pos, InputIt first, InputIt last)
+{
+	iterator tail = pos;
+	for (; first != last; ++first) {
+		tail = emplace_after(tail, *first);
+	}
+
+	return tail;
+}
+
+template<class T>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::insert_after(const_iterator pos, std::initializer_list<value_type> ilist)
+{
+	return insert_after(pos, ilist.begin(), ilist.end());
+}
+
+template<class T>
+template<class... Args>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::emplace_after(const_iterator pos, Args&&... args)
+{
+	// Before the head exists the only valid position is the (null)
+	// before_begin() of a const view, which maps onto the new head.
+	auto prev = m_head ? node_at(pos.item) : head();
+	auto n = make_node(std::forward<Args>(args)...);
+	n->next = std::move(prev->next);
+	prev->next = n;
+
+	return iterator(n);
+}
+
+template<class T>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::erase_after(const_iterator pos)
+{
+	auto prev = node_at(pos.item);
+	auto victim = std::move(prev->next);
+	if (!victim) {
+		throw std::range_error("Nothing to erase after the last element");
+	}
+
+	prev->next = std::move(victim->next);
+
+	return iterator(prev->next);
+}
+
+template<class T>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::erase_after(const_iterator first, const_iterator last)
+{
+	auto prev = node_at(first.item);
+	auto stop = last.item.lock();
+
+	// Cut the range out first, then free it one node at a time.
+	auto chain = std::move(prev->next);
+	auto tail = &chain;
+	while (*tail && *tail != stop) {
+		tail = &(*tail)->next;
+	}
+	prev->next = std::move(*tail);
+	release_chain(std::move(chain));
+
+	return iterator(prev->next);
+}
+
+template<class T>
+void safe_forward_list<T>::push_front(const value_type& value)
+{
+	emplace_after(before_begin(), value);
+}
+
+template<class T>
+void safe_forward_list<T>::push_front(value_type&& value)
+{
+	emplace_after(before_begin(), std::move(value));
+}
+
+template<class T>
+template<class... Args>
+void safe_forward_list<T>::emplace_front(Args&&... args)
+{
+	emplace_after(before_begin(), std::forward<Args>(args)...);
+}
+
+template<class T>
+void safe_forward_list<T>::pop_front()
+{
+	if (!empty()) {
+		erase_after(before_begin());
+	}
+}
+
+template<class T>
+void safe_forward_list<T>::resize(size_type count)
+{
+	auto prev = before_begin();
+	for (; count > 0 && std::next(prev) != end(); --count) {
+		++prev;
+	}
+
+	if (count == 0) {
+		erase_after(prev, end());
+	} else {
+		for (; count > 0; --count) {
+			prev = emplace_after(prev);
+		}
+	}
+}
+
+template<class T>
+void safe_forward_list<T>::resize(size_type count, const value_type& value)
+{
+	auto prev = before_begin();
+	for (; count > 0 && std::next(prev) != end(); --count) {
+		++prev;
+	}
+
+	if (count == 0) {
+		erase_after(prev, end());
+	} else {
+		insert_after(prev, count, value);
+	}
+}
+
+// Operations
+template<class T>
+template<class Compare>
+void safe_forward_list<T>::merge(safe_forward_list& other, Compare comp)
+{
+	if (&other == this || other.empty()) {
+		return;
+	}
+
+	merge_chains(head()->next, other.m_head->next, comp);
+}
+
+template<class T>
+void safe_forward_list<T>::splice_after(const_iterator pos, safe_forward_list& other)
+{
+	if (&other == this || other.empty()) {
+		return;
+	}
+
+	splice_after(pos, other, other.before_begin(), other.end());
+}
+
+template<class T>
+void safe_forward_list<T>::splice_after(const_iterator pos, safe_forward_list&, const_iterator it)
+{
+	auto prev = node_at(pos.item);
+	auto before = node_at(it.item);
+	auto moved = before->next;
+	if (!moved || moved == prev || prev == before) {
+		// Nothing to move, or moving an element to where it already is.
+		return;
+	}
+
+	before->next = std::move(moved->next);
+	moved->next = std::move(prev->next);
+	prev->next = std::move(moved);
+}
+
+// Moves the elements strictly between first and last.
+template<class T>
+void safe_forward_list<T>::splice_after(const_iterator pos, safe_forward_list&, const_iterator first, const_iterator last)
+{
+	auto prev = node_at(pos.item);
+	auto before = node_at(first.item);
+	auto stop = last.item.lock();
+	if (before->next == stop) {
+		return;
+	}
+
+	auto tail = &before->next;
+	while ((*tail)->next != stop) {
+		tail = &(*tail)->next;
+	}
+
+	auto chain = std::move(before->next);
+	before->next = std::move((*tail)->next);
+	(*tail)->next = std::move(prev->next);
+	prev->next = std::move(chain);
+}
+
+template<class T>
+void safe_forward_list<T>::remove(const value_type& value)
+{
+	remove_if([&value](const value_type& v) { return v == value; });
+}
+
+template<class T>
+template<class UnaryPredicate>
+void safe_forward_list<T>::remove_if(UnaryPredicate pred)
+{
+	if (empty()) {
+		return;
+	}
+
+	// Walk the owning links, so that nothing is copied on the way. Removed
+	// nodes are kept until the end, as pred may refer to one of them.
+	link_t removed;
+	auto link = &m_head->next;
+	while (*link) {
+		if (pred(value_of(*link))) {
+			auto victim = std::move(*link);
+			*link = std::move(victim->next);
+			victim->next = std::move(removed);
+			removed = std::move(victim);
+		} else {
+			link = &(*link)->next;
+		}
+	}
+
+	release_chain(std::move(removed));
+}
+
+template<class T>
+void safe_forward_list<T>::reverse() noexcept
+{
+	if (empty()) {
+		return;
+	}
+
+	link_t reversed;
+	auto n = std::move(m_head->next);
+	while (n) {
+		auto next = std::move(n->next);
+		n->next = std::move(reversed);
+		reversed = std::move(n);
+		n = std::move(next);
+	}
+
+	m_head->next = std::move(reversed);
+}
+
+template<class T>
+template<class BinaryPredicate>
+void safe_forward_list<T>::unique(BinaryPredicate pred)
+{
+	if (empty()) {
+		return;
+	}
+
+	auto prev = m_head->next.get();
+	while (prev->next) {
+		if (pred(static_cast<node&>(*prev).value, value_of(prev->next))) {
+			auto victim = std::move(prev->next);
+			prev->next = std::move(victim->next);
+		} else {
+			prev = prev->next.get();
+		}
+	}
+}
+
+template<class T>
+template<class Compare>
+void safe_forward_list<T>::sort(Compare comp)
+{
+	if (empty() || !m_head->next->next) {
+		return; // Already sorted.
+	}
+
+	// Same bottom-up merge sort as safelist: bins[i] holds a sorted run of
+	// 2^i elements, older elements in higher bins.
+	link_t bins[std::numeric_limits<size_type>::digits];
+	link_t carry, sorted;
+	auto n = std::move(m_head->next);
+
+	try {
+		while (n) {
+			carry = std::move(n);
+			n = std::move(carry->next);
+
+			std::size_t i = 0;
+			for (; bins[i]; ++i) {
+				merge_chains(bins[i], carry, comp);
+				carry = std::move(bins[i]);
+			}
+			bins[i] = std::move(carry);
+		}
+
+		for (auto& bin : bins) {
+			if (bin) {
+				merge_chains(bin, sorted, comp);
+				sorted = std::move(bin);
+			}
+		}
+	} catch (...) {
+		// Keep every element, in whatever order the pieces are in.
+		auto tail = &n;
+		for (auto& bin : bins) {
+			while (*tail) {
+				tail = &(*tail)->next;
+			}
+			*tail = std::move(bin);
+		}
+		for (auto chain : {&carry, &sorted}) {
+			while (*tail) {
+				tail = &(*tail)->next;
+			}
+			*tail = std::move(*chain);
+		}
+
+		m_head->next = std::move(n);
+		throw;
+	}
+
+	m_head->next = std::move(sorted);
+}
+
+// Comparisons
+template<class T>
+bool safe_forward_list<T>::operator==(const safe_forward_list& other) const
+{
+	auto a = begin(), b = other.begin();
+	for (; a != end() && b != other.end(); ++a, ++b) {
+		if (!(*a == *b)) {
+			return false;
+		}
+	}
+
+	return a == end() && b == other.end();
+}
+
+template<class T>
+bool safe_forward_list<T>::operator!=(const safe_forward_list& other) const
+{
+	return !(*this == other);
+}
+
+template<class T>
+bool safe_forward_list<T>::operator<(const safe_forward_list& other) const
+{
+	return std::lexicographical_compare(begin(), end(), other.begin(), other.end());
+}
+
+template<class T>
+bool safe_forward_list<T>::operator<=(const safe_forward_list& other) const
+{
+	return !(other < *this);
+}
+
+template<class T>
+bool safe_forward_list<T>::operator>(const safe_forward_list& other) const
+{
+	return other < *this;
+}
+
+template<class T>
+bool safe_forward_list<T>::operator>=(const safe_forward_list& other) const
+{
+	return !(*this < other);
+}
+
+// Private helpers
+template<class T>
+const typename safe_forward_list<T>::link_t& safe_forward_list<T>::head()
+{
+	if (!m_head) {
+		m_head = std::make_shared<node_base>();
+	}
+
+	return m_head;
+}
+
+template<class T>
+typename safe_forward_list<T>::link_t safe_forward_list<T>::node_at(const std::weak_ptr<node_base>& pos)
+{
+	auto n = pos.lock();
+	if (!n) {
+		throw std::range_error("Iterator does not point to a node");
+	}
+
+	return n;
+}
+
+// The control block, the link and the value share one allocation.
+template<class T>
+template<class... Args>
+typename safe_forward_list<T>::link_t safe_forward_list<T>::make_node(Args&&... args)
+{
+	return std::make_shared<node>(std::forward<Args>(args)...);
+}
+
+// Frees a chain one node at a time, rather than recursively.
+template<class T>
+void safe_forward_list<T>::release_chain(link_t chain)
+{
+	while (chain && chain.use_count() == 1) {
+		auto next = std::move(chain->next);
+		chain = std::move(next);
+	}
+}
+
+// Stable merge of two sorted chains into a, leaving b empty; on ties,
+// elements of a go first. If comp throws, a still holds every element.
+template<class T>
+template<class Compare>
+void safe_forward_list<T>::merge_chains(link_t& a, link_t& b, Compare& comp)
+{
+	link_t head;
+	auto tail = &head;
+
+	try {
+		while (a && b) {
+			auto& from = comp(value_of(b), value_of(a)) ? b : a;
+			*tail = std::move(from);
+			from = std::move((*tail)->next);
+			tail = &(*tail)->next;
+		}
+	} catch (...) {
+		*tail = std::move(a);
+		while (*tail) {
+			tail = &(*tail)->next;
+		}
+		*tail = std::move(b);
+		a = std::move(head);
+		throw;
+	}
+
+	*tail = a ? std::move(a) : std::move(b);
+	a = std::move(head);
+}
+
+// Iterator functions
+template<class T>
+typename safe_forward_list<T>::iterator& safe_forward_list<T>::iterator::operator++()
+{
+	item = node_at(item)->next;
+	before_begin = false;
+
+	return *this;
+}
+
+template<class T>
+typename safe_forward_list<T>::iterator safe_forward_list<T>::iterator::operator++(int)
+{
+	iterator copy = *this;
+	++(*this);
+
+	return copy;
+}
+
+template<class T>
+T& safe_forward_list<T>::iterator::operator*() const
+{
+	if (before_begin) {
+		throw std::range_error("Unable to dereference before_begin()");
+	}
+
+	return value_of(node_at(item));
+}
+
+template<class T>
+bool safe_forward_list<T>::iterator::operator==(const iterator& other) const
+{
+	return !item.owner_before(other.item) && !other.item.owner_before(item);
+}
+
+template<class T>
+typename safe_forward_list<T>::const_iterator& safe_forward_list<T>::const_iterator::operator++()
+{
+	item = node_at(item)->next;
+	before_begin = false;
+
+	return *this;
+}
+
+template<class T>
+typename safe_forward_list<T>::const_iterator safe_forward_list<T>::const_iterator::operator++(int)
+{
+	const_iterator copy = *this;
+	++(*this);
+
+	return copy;
+}
+
+template<class T>
+const T& safe_forward_list<T>::const_iterator::operator*() const
+{
+	if (before_begin) {
+		throw std::range_error("Unable to dereference before_begin()");
+	}
+
+	return value_of(node_at(item));
+}
+
+template<class T>
+bool safe_forward_list<T>::const_iterator::operator==(const const_iterator& other) const
+{
+	return !item.owner_before(other.item) && !other.item.owner_before(item);
+}
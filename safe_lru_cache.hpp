@@ -0,0 +1,177 @@
+#pragma once
+
+#include "safelist.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+// Default weigher: every entry counts as one, so the capacity is a count.
+template<class Key, class Value>
+struct lru_unit_weight
+{
+	std::size_t operator()(const Key&, const Value&) const
+	{
+		return 1;
+	}
+};
+
+// Least-recently-used cache with its recency order kept in a safelist.
+//
+// The most recently used entry is at the front. A hit moves its node to the
+// front with a single-node splice, so nothing is allocated or copied, and
+// eviction pops from the back until the total weight fits the capacity.
+template<class Key, class Value,
+	class Weigher = lru_unit_weight<Key, Value>,
+	class Hash = std::hash<Key>,
+	class KeyEqual = std::equal_to<Key>>
+class safe_lru_cache
+{
+	public:
+		typedef Key key_type;
+		typedef Value mapped_type;
+		typedef std::pair<const Key, Value> value_type;
+		typedef std::size_t size_type;
+
+		typedef typename safelist<value_type>::iterator iterator;
+		typedef typename safelist<value_type>::const_iterator const_iterator;
+
+		explicit safe_lru_cache(size_type capacity, Weigher weigher = Weigher());
+
+		// Looks up a key and marks it as most recently used. Returns end()
+		// on a miss.
+		iterator find(const key_type& key);
+
+		// Looks up a key without changing the recency order.
+		const_iterator peek(const key_type& key) const;
+
+		// Inserts or overwrites a key, marks it as most recently used and
+		// evicts from the back until the cache fits its capacity again.
+		void put(const key_type& key, const mapped_type& value);
+
+		bool erase(const key_type& key);
+		void clear();
+
+		size_type count(const key_type& key) const { return index.count(key); };
+		size_type size() const { return order.size(); };
+		bool empty() const { return order.empty(); };
+		size_type weight() const { return m_weight; };
+		size_type capacity() const { return m_capacity; };
+		size_type evictions() const { return m_evictions; };
+
+		iterator begin() { return order.begin(); };
+		iterator end() { return order.end(); };
+		const_iterator begin() const { return order.begin(); };
+		const_iterator end() const { return order.end(); };
+
+	private:
+		safelist<value_type> order;
+		std::unordered_map<Key, iterator, Hash, KeyEqual> index;
+
+		Weigher weigher;
+		size_type m_capacity;
+		size_type m_weight;
+		size_type m_evictions;
+
+		void evict();
+};
+
+template<class Key, class Value, class Weigher, class Hash, class KeyEqual>
+safe_lru_cache<Key, Value, Weigher, Hash, KeyEqual>::safe_lru_cache(size_type capacity, Weigher weigher):
+	weigher(weigher),
+	m_capacity(capacity),
+	m_weight(0),
+	m_evictions(0)
+{
+}
+
+template<class Key, class Value, class Weigher, class Hash, class KeyEqual>
+typename safe_lru_cache<Key, Value, Weigher, Hash, KeyEqual>::iterator
+safe_lru_cache<Key, Value, Weigher, Hash, KeyEqual>::find(const key_type& key)
+{
+	auto found = index.find(key);
+	if (found == index.end()) {
+		return order.end();
+	}
+
+	order.splice(order.begin(), order, found->second);
+
+	return found->second;
+}
+
+template<class Key, class Value, class Weigher, class Hash, class KeyEqual>
+typename safe_lru_cache<Key, Value, Weigher, Hash, KeyEqual>::const_iterator
+safe_lru_cache<Key, Value, Weigher, Hash, KeyEqual>::peek(const key_type& key) const
+{
+	auto found = index.find(key);
+	if (found == index.end()) {
+		return order.end();
+	}
+
+	return found->second;
+}
+
+template<class Key, class Value, class Weigher, class Hash, class KeyEqual>
+void safe_lru_cache<Key, Value, Weigher, Hash, KeyEqual>::put(const key_type& key, const mapped_type& value)
+{
+	const auto weight = weigher(key, value);
+
+	auto found = index.find(key);
+	if (found != index.end()) {
+		auto& item = *found->second;
+		const auto old = weigher(item.first, item.second);
+		item.second = value;
+		m_weight -= old;
+		order.splice(order.begin(), order, found->second);
+	} else {
+		// The node must not outlive a failed insertion into the index, or
+		// it could never be evicted by key.
+		order.push_front(value_type(key, value));
+		try {
+			index.emplace(key, order.begin());
+		} catch (...) {
+			order.pop_front();
+			throw;
+		}
+	}
+
+	m_weight += weight;
+	evict();
+}
+
+template<class Key, class Value, class Weigher, class Hash, class KeyEqual>
+bool safe_lru_cache<Key, Value, Weigher, Hash, KeyEqual>::erase(const key_type& key)
+{
+	auto found = index.find(key);
+	if (found == index.end()) {
+		return false;
+	}
+
+	auto& item = *found->second;
+	m_weight -= weigher(item.first, item.second);
+	order.erase(found->second);
+	index.erase(found);
+
+	return true;
+}
+
+template<class Key, class Value, class Weigher, class Hash, class KeyEqual>
+void safe_lru_cache<Key, Value, Weigher, Hash, KeyEqual>::clear()
+{
+	index.clear();
+	order.clear();
+	m_weight = 0;
+}
+
+template<class Key, class Value, class Weigher, class Hash, class KeyEqual>
+void safe_lru_cache<Key, Value, Weigher, Hash, KeyEqual>::evict()
+{
+	while (m_weight > m_capacity && !order.empty()) {
+		auto& item = order.back();
+		m_weight -= weigher(item.first, item.second);
+		index.erase(item.first);
+		order.pop_back();
+		++m_evictions;
+	}
+}
@@ -2,13 +2,20 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <initializer_list>
+#include <iterator>
 #include <functional>
 #include <limits>
 #include <memory>
+#include <new>
 #include <stdexcept>
 #include <type_traits>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #if __cplusplus < 201300
 namespace std {
@@ -34,6 +41,8 @@ class safelist
 
 		class iterator;
 		class const_iterator;
+		class node_type;
+		class reclaimer;
 		typedef std::reverse_iterator<iterator> reverse_iterator;
 		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
 
@@ -48,22 +57,30 @@ class safelist
 			using if_is_compatible_iterator = std::enable_if<is_compatible_iterator<Iterator>::value>;
 
 		// Constructors
-		safelist();
+		safelist() noexcept;
 		safelist(size_type count);
 		safelist(size_type count, const value_type& v);
 		safelist(const safelist<value_type>& other);
-		safelist(safelist<value_type>&&);
+		safelist(safelist<value_type>&&) noexcept;
 		safelist(std::initializer_list<value_type> l);
 		template<class InputIt,
 			typename = typename if_is_compatible_iterator<InputIt>::type>
 				safelist(InputIt first, InputIt last);
 
-		void swap(safelist& other);
+		void swap(safelist& other) noexcept;
 
 		// Assignment operators
 		safelist<value_type>& operator=(const safelist<value_type>& other);
-		safelist<value_type>& operator=(safelist<value_type>&& other);
+		safelist<value_type>& operator=(safelist<value_type>&& other) noexcept;
+		safelist<value_type>& operator=(std::initializer_list<value_type> ilist);
 
+		// Assignment reuses the existing entries, so it only allocates for
+		// elements beyond the current size.
+		void assign(size_type count, const value_type& value);
+		template<class InputIt,
+			typename = typename if_is_compatible_iterator<InputIt>::type>
+		void assign(InputIt first, InputIt last);
+		void assign(std::initializer_list<value_type> ilist);
 
 		~safelist();
 
@@ -94,6 +111,14 @@ class safelist
 		iterator erase(const_iterator iter);
 		iterator erase(const_iterator first, const_iterator last);
 
+		// Node handles. extract() takes an element out of the list without
+		// freeing it, and insert() puts it back in this list or any other of
+		// the same type, so neither allocates. Iterators to the element
+		// follow it into its new list. Inserting an empty handle does
+		// nothing and returns pos.
+		node_type extract(const_iterator pos);
+		iterator insert(const_iterator pos, node_type&& node);
+
 		// (re)sizing
 		size_type size() const;
 		size_type max_size() const;
@@ -129,22 +154,88 @@ class safelist
 		template<class Compare = std::less<value_type>>
 		void sort(Compare compare = Compare());
 
+		// Stable sort on a key that is extracted once per element. Integral
+		// keys are radix sorted, other keys use a comparison sort.
+		template<class KeyFunction>
+		void sort_by_key(KeyFunction key);
+
 		template<class Compare = std::less<value_type>>
 		void merge(safelist& other, Compare compare = Compare());
 
+		// Merges every sorted list in a range into this one in a single
+		// pass, leaving them empty. Equal elements keep the order of
+		// their lists, with this list first. If compare throws, the
+		// elements not merged yet are kept at the end of this list.
+		template<class Range, class Compare = std::less<value_type>>
+		void merge_all(Range&& lists, Compare compare = Compare());
+
 		template<class BinaryPredicate = std::equal_to<value_type>>
 		void unique(BinaryPredicate pred = BinaryPredicate());
 
+		// Hash based counterparts of unique() and the set algorithms. They
+		// keep the order of the elements, and run in linear time on
+		// average, indexing the elements by address so nothing is copied.
+		//
+		// unique_unordered() keeps the first of every group of equal
+		// elements. difference_with() erases the elements that equal one
+		// in other, and intersect_with() those that do not. union_with()
+		// moves the elements of other that equal none in this list, nor
+		// one moved before them, to the end; other keeps the rest.
+		template<class Hash = std::hash<value_type>, class KeyEqual = std::equal_to<value_type>>
+		void unique_unordered(Hash hash = Hash(), KeyEqual eq = KeyEqual());
+		template<class Hash = std::hash<value_type>, class KeyEqual = std::equal_to<value_type>>
+		void difference_with(const safelist& other, Hash hash = Hash(), KeyEqual eq = KeyEqual());
+		template<class Hash = std::hash<value_type>, class KeyEqual = std::equal_to<value_type>>
+		void intersect_with(const safelist& other, Hash hash = Hash(), KeyEqual eq = KeyEqual());
+		template<class Hash = std::hash<value_type>, class KeyEqual = std::equal_to<value_type>>
+		void union_with(safelist& other, Hash hash = Hash(), KeyEqual eq = KeyEqual());
+
+		// Reversing only flips the list's orientation, so it takes constant
+		// time. Iterators read the orientation of the list their element
+		// is in on every step, so those taken before the call move in the
+		// new direction. normalize() makes the entries follow the current
+		// orientation again; operations that relink in bulk do so first.
 		void reverse();
+		void normalize();
+
 		void remove(const value_type& value);
 
 		template<class UnaryPredicate>
 		void remove_if(UnaryPredicate pred);
 
+		// How scattered the entries are in memory, to decide whether a
+		// defragment() is worth it.
+		struct layout_stats
+		{
+			size_type links;     // pairs of consecutive elements
+			size_type far_links; // pairs whose entries are far apart
+			double fragmentation() const { return links ? double(far_links) / links : 0; }
+		};
+		layout_stats layout() const;
+
+		// Moves the entries into a single block, in list order. Values are
+		// not moved, so references to elements stay valid, but iterators
+		// other than end() expire as their entries are replaced.
+		void defragment();
+
 		void splice(const_iterator pos, safelist& other);
 		void splice(const_iterator pos, safelist& other, const_iterator it);
 		void splice(const_iterator pos, safelist& other, const_iterator first, const_iterator last);
 
+		// Moves [pos, end()) into a new list. Only the links at the cut
+		// change, and the shorter side of it is counted to fix the sizes.
+		// The new list's sentinel is the only allocation.
+		safelist split_at(const_iterator pos);
+
+		// Puts the elements for which pred holds first, and returns an
+		// iterator to the first of the others. partition() swaps values
+		// between entries, stable_partition() relinks the entries in one
+		// pass. Neither copies or allocates.
+		template<class UnaryPredicate>
+		iterator partition(UnaryPredicate pred);
+		template<class UnaryPredicate>
+		iterator stable_partition(UnaryPredicate pred);
+
 		// Comparisons
 		bool operator<(const safelist& other) const;
 		bool operator<=(const safelist& other) const;
@@ -154,13 +245,153 @@ class safelist
 		bool operator==(const safelist& other) const;
 		bool operator!=(const safelist& other) const;
 
+		// Content hashing. Once enabled, a hash of the elements is kept
+		// up to date by every operation, in O(1) for single-element
+		// changes, and operator== uses it to tell most unequal lists apart
+		// without walking them. hash() combines the elements in order; it
+		// walks the list the first time it is called after a change, and
+		// is cached until the next one. Elements changed in place, through
+		// references or iterators, are not noticed: call rehash() after
+		// doing so.
+		//
+		// Copy assignment keeps the setting of the list assigned to.
+		// Moving and swapping take it along with the elements, and leave
+		// a moved-from list without it.
+		template<class Hash = std::hash<value_type>>
+		void enable_hash();
+		void disable_hash();
+		bool hash_enabled() const { return m_hasher != nullptr; };
+
+		// Throws std::logic_error if hashing is not enabled.
+		std::size_t hash() const;
+		void rehash();
+
+		// Deferred reclamation. Freeing entries one by one takes time in
+		// proportion to their number. With a reclaimer set, clear(), the
+		// destructor, move assignment and erasing a range only detach the
+		// entries, and leave it to the reclaimer to free them a few at a
+		// time. Erasing a range still walks it, to count it. Iterators to
+		// detached entries can still be read and moved along until those
+		// are freed, but calls that change the list reject them.
+		//
+		// The reclaimer must outlive the list. It goes along with the
+		// elements the same way the hash setting does; the entries a move
+		// assignment replaces go to the reclaimer of the list assigned to.
+		void set_reclaimer(reclaimer* r) { m_reclaimer = r; };
+		reclaimer* get_reclaimer() const { return m_reclaimer; };
+
 	private:
 		struct entry;
+		struct sentinel_entry;
 		size_type m_size;
-
+		// Mirrored in the owner flag the entries share, where iterators
+		// read it.
+		bool m_reversed;
+		void set_reversed(bool reversed);
+
+		// The hash is the sum of a hash of every pair of neighbours, the
+		// sentinel included, so it can be patched up around a change.
+		// m_hash[1] is the same for the list read backwards, which lets
+		// reverse() stay O(1).
+		typedef std::size_t (*hash_function)(const value_type&);
+		hash_function m_hasher;
+		std::uint64_t m_hash[2];
+
+		// The pair sums are the same for lists that only differ in the
+		// order of repeated runs, such as 1 2 1 3 1 and 1 3 1 2 1, so
+		// hash() chains the elements instead. Any change to the pair sums
+		// clears m_ordered_valid.
+		mutable std::uint64_t m_ordered;
+		mutable bool m_ordered_valid;
+
+		template<class Hash>
+		static std::size_t hash_value(const value_type& v) { return Hash()(v); };
+		std::uint64_t element_hash(const std::shared_ptr<entry>& e) const;
+		static std::uint64_t pair_hash(std::uint64_t first, std::uint64_t second);
+		void hash_link(std::uint64_t first, std::uint64_t second);
+		void hash_unlink(std::uint64_t first, std::uint64_t second);
+		void reset_hash();
+
+		reclaimer* m_reclaimer;
+
+		// Hands a detached chain to the reclaimer, or frees it right away.
+		void release(std::shared_ptr<entry> chain) noexcept;
+
+		// Created on first use, so empty and moved-from lists own nothing.
 		std::shared_ptr<entry> entryPoint;
 
+		// Entries are allocated apart from their control block, so an
+		// iterator that outlives its element only keeps the control block.
+		template<class... Args>
+		static std::shared_ptr<entry> make_entry(Args&&... args);
+
+		inline const std::shared_ptr<entry>& sentinel();
+		void release_sentinel() noexcept;
+		void adopt(entry* first, const entry* last);
 		inline std::shared_ptr<entry> iterator_entry(const_iterator& it);
+		inline std::shared_ptr<entry> position_entry(const_iterator& pos);
+
+		// Erased entries keep their links for the iterators still on them,
+		// and are marked by moving them to a flag no list owns.
+		static const typename entry::owner_ptr_t& detached(bool reversed);
+		void check_member(const entry& e) const;
+
+		static void release_chain(std::shared_ptr<entry> chain);
+
+		// Neighbours and linking in the list's current orientation.
+		std::shared_ptr<entry> next_of(const std::shared_ptr<entry>& e) const;
+		std::shared_ptr<entry> prev_of(const std::shared_ptr<entry>& e) const;
+		void link(const std::shared_ptr<entry>& first, const std::shared_ptr<entry>& second);
+		void insert_entry(const std::shared_ptr<entry>& pos, const std::shared_ptr<entry>& e);
+		void unlink_entry(const std::shared_ptr<entry>& e);
+
+		// Helpers for working on the elements as a null-terminated chain.
+		std::shared_ptr<entry> detach_chain();
+		void attach_chain(std::shared_ptr<entry> chain);
+
+		template<class Key>
+		using is_radix_key = std::integral_constant<bool,
+			std::is_integral<Key>::value && !std::is_same<Key, bool>::value>;
+
+		template<class Key>
+		static void sort_keys(std::vector<std::pair<Key, size_type>>& keys, std::true_type);
+		template<class Key>
+		static void sort_keys(std::vector<std::pair<Key, size_type>>& keys, std::false_type);
+
+		// Set of elements by address, hashed and compared by value.
+		template<class Hash>
+		struct indirect_hash
+		{
+			Hash hash;
+			std::size_t operator()(const value_type* v) const { return hash(*v); };
+		};
+
+		template<class KeyEqual>
+		struct indirect_equal
+		{
+			KeyEqual eq;
+			bool operator()(const value_type* a, const value_type* b) const { return eq(*a, *b); };
+		};
+
+		template<class Hash, class KeyEqual>
+		using value_set = std::unordered_set<const value_type*, indirect_hash<Hash>, indirect_equal<KeyEqual>>;
+
+		template<class Hash, class KeyEqual>
+		static value_set<Hash, KeyEqual> value_index(const safelist& l, Hash& hash, KeyEqual& eq);
+
+		// Erases the elements for which the index's verdict is not keep.
+		template<class Hash, class KeyEqual>
+		void filter(const value_set<Hash, KeyEqual>& index, bool keep);
+
+		template<class Compare>
+		static void merge_chains(std::shared_ptr<entry>& a, std::shared_ptr<entry>& b, Compare& comp);
+		template<class InRun>
+		static entry* run_end(entry* first, const entry* stop, InRun in_run);
+
+		// Storage for defragment(): entries are carved out of one block,
+		// which is freed when the last of them goes away.
+		class entry_arena;
+		struct arena_delete;
 };
 
 template<class T>
@@ -186,6 +417,7 @@ class safelist<T>::iterator
 		iterator operator--(int);
 
 		reference operator*() const;
+		pointer operator->() const;
 		bool operator==(const iterator&) const;
 		bool operator!=(const iterator&) const;
 
@@ -196,7 +428,7 @@ class safelist<T>::iterator
 		std::weak_ptr<entry> item;
 
 		iterator(const std::weak_ptr<entry>& item): item(item) {};
-		iterator(const_iterator);
+		explicit iterator(const_iterator);
 };
 
 template<class T>
@@ -223,6 +455,7 @@ class safelist<T>::const_iterator
 		const_iterator operator--(int);
 
 		const_reference operator*() const;
+		pointer operator->() const;
 		bool operator==(const const_iterator&) const;
 		bool operator!=(const const_iterator&) const;
 
@@ -235,16 +468,74 @@ class safelist<T>::const_iterator
 		const_iterator(const std::weak_ptr<entry>& item): item(item) {};
 };
 
+// Frees the entries of detached chains, a budget at a time, on the thread
+// that calls reclaim(). Not thread safe: a thread freeing the chains would
+// race with stale iterators walking them.
+template<class T>
+class safelist<T>::reclaimer
+{
+	public:
+		friend safelist<T>;
+
+		reclaimer() = default;
+		reclaimer(const reclaimer&) = delete;
+		reclaimer& operator=(const reclaimer&) = delete;
+
+		// Frees whatever is left.
+		~reclaimer();
+
+		// Frees up to budget entries, and returns how many it freed.
+		size_type reclaim(size_type budget);
+
+		// Whether any chain is left to free.
+		bool pending() const { return !chains.empty(); };
+
+	private:
+		std::vector<std::shared_ptr<entry>> chains;
+};
+
+// Owns an element while it is outside any list. The value can be changed
+// in the meantime, through value().
+template<class T>
+class safelist<T>::node_type
+{
+	public:
+		friend safelist<T>;
+
+		typedef T value_type;
+
+		node_type() = default;
+		node_type(node_type&&) = default;
+		node_type& operator=(node_type&&) = default;
+
+		bool empty() const noexcept { return !item; };
+		explicit operator bool() const noexcept { return !empty(); };
+
+		// Throws std::logic_error if the handle is empty.
+		value_type& value() const;
+
+		void swap(node_type& other) noexcept { std::swap(item, other.item); };
+
+	private:
+		std::shared_ptr<entry> item;
+
+		explicit node_type(std::shared_ptr<entry> item): item(std::move(item)) {};
+};
+
 template<class T>
 struct safelist<T>::entry
 {
 	typedef std::weak_ptr<entry> prev_ptr_t;
 	typedef std::shared_ptr<entry> next_ptr_t;
 	typedef std::unique_ptr<value_type> value_ptr_t;
+	typedef std::shared_ptr<bool> owner_ptr_t;
 
 	prev_ptr_t prev;
 	next_ptr_t next;
 	value_ptr_t value;
+	// The orientation flag of the list the entry is in. Entries get the
+	// flag of the list they move to, so iterators follow their element.
+	owner_ptr_t owner;
 
 	entry()
 	{
@@ -262,6 +553,11 @@ struct safelist<T>::entry
 	{
 	}
 
+	explicit entry(value_ptr_t&& value) :
+		value(std::move(value))
+	{
+	}
+
 	entry(value_ptr_t&& value, const next_ptr_t& next, const prev_ptr_t& prev) :
 		prev(prev),
 		next(next),
@@ -277,12 +573,66 @@ struct safelist<T>::entry
 	}
 };
 
+// Storage for the orientation flag of a new list. The sentinel's owner
+// points here, which keeps the sentinel alive until the list breaks that
+// cycle when it lets go of it.
+template<class T>
+struct safelist<T>::sentinel_entry: entry
+{
+	bool reversed = false;
+};
+
+
+template<class T>
+class safelist<T>::entry_arena
+{
+	public:
+		explicit entry_arena(size_type count): m_count(count), m_block(nullptr), m_used(0), m_capacity(0) {}
+		~entry_arena();
+
+		entry_arena(const entry_arena&) = delete;
+		entry_arena& operator=(const entry_arena&) = delete;
+
+		void* allocate(std::size_t bytes);
+		static void deallocate(void* p);
+
+	private:
+		struct block
+		{
+			size_type live;
+		};
+
+		// Every allocation is preceded by a pointer to its block, padded
+		// to keep the allocation itself aligned.
+		static const std::size_t header = alignof(std::max_align_t);
+
+		static std::size_t padded(std::size_t bytes)
+		{
+			return (bytes + header - 1) / header * header;
+		}
+
+		static void release(block* b);
+
+		size_type m_count;
+		block* m_block;
+		std::size_t m_used;
+		std::size_t m_capacity;
+};
+
+template<class T>
+struct safelist<T>::arena_delete
+{
+	void operator()(entry* e) const
+	{
+		e->~entry();
+		entry_arena::deallocate(e);
+	}
+};
 
 // Constructor definitions
 template<class T>
-safelist<T>::safelist(): entryPoint(std::make_shared<entry>())
+safelist<T>::safelist() noexcept: m_size(0), m_reversed(false), m_hasher(nullptr), m_hash(), m_ordered(0), m_ordered_valid(false), m_reclaimer(nullptr)
 {
-	clear();
 }
 
 template<class T>
@@ -313,13 +663,29 @@ safelist<T>::safelist(InputIt first, InputIt last): safelist()
 template<class T>
 safelist<T>::safelist(const safelist<T>& other): safelist(other.begin(), other.end())
 {
+	m_hasher = other.m_hasher;
+	m_hash[0] = other.m_hash[0];
+	m_hash[1] = other.m_hash[1];
+	m_ordered = other.m_ordered;
+	m_ordered_valid = other.m_ordered_valid;
+	m_reclaimer = other.m_reclaimer;
 }
 
 template<class T>
-safelist<T>::safelist(safelist<T>&& other)
+safelist<T>::safelist(safelist<T>&& other) noexcept:
+	m_size(other.m_size),
+	m_reversed(other.m_reversed),
+	m_hasher(other.m_hasher),
+	m_hash{other.m_hash[0], other.m_hash[1]},
+	m_ordered(other.m_ordered),
+	m_ordered_valid(other.m_ordered_valid),
+	m_reclaimer(other.m_reclaimer),
+	entryPoint(std::move(other.entryPoint))
 {
-	m_size = other.size();
-	entryPoint = std::move(other.entryPoint);
+	other.m_size = 0;
+	other.m_reversed = false;
+	other.m_hasher = nullptr;
+	other.m_reclaimer = nullptr;
 }
 
 template<class T>
@@ -330,16 +696,20 @@ safelist<T>::safelist(std::initializer_list<value_type> l): safelist(l.begin(),
 template<class T>
 safelist<T>::~safelist()
 {
-	if (entryPoint) {
-		entryPoint->next = nullptr;
-	}
+	release_sentinel();
 }
 
 template<class T>
-void safelist<T>::swap(safelist& other)
+void safelist<T>::swap(safelist& other) noexcept
 {
 	std::swap(entryPoint, other.entryPoint);
 	std::swap(m_size, other.m_size);
+	std::swap(m_reversed, other.m_reversed);
+	std::swap(m_hasher, other.m_hasher);
+	std::swap(m_hash, other.m_hash);
+	std::swap(m_ordered, other.m_ordered);
+	std::swap(m_ordered_valid, other.m_ordered_valid);
+	std::swap(m_reclaimer, other.m_reclaimer);
 }
 
 template<class T>
@@ -352,32 +722,120 @@ void swap(safelist<T>& a, safelist<T>& b)
 template<class T>
 safelist<T>& safelist<T>::operator=(const safelist<T>& other)
 {
-	clear();
-	for (auto &entry : other) {
-		push_back(entry);
+	if (&other == this) {
+		return *this;
 	}
 
+	assign(other.begin(), other.end());
+
 	return *this;
 }
 
 template<class T>
-safelist<T>& safelist<T>::operator=(safelist<T>&& other)
+safelist<T>& safelist<T>::operator=(safelist<T>&& other) noexcept
 {
-	entryPoint->next = nullptr; // Need to break the ring of references
+	if (&other == this) {
+		return *this;
+	}
+
+	release_sentinel();
 	entryPoint = std::move(other.entryPoint); // Take other list entrypoint
 	m_size = other.m_size;
+	m_reversed = other.m_reversed;
+	m_hasher = other.m_hasher;
+	m_hash[0] = other.m_hash[0];
+	m_hash[1] = other.m_hash[1];
+	m_ordered = other.m_ordered;
+	m_ordered_valid = other.m_ordered_valid;
+	m_reclaimer = other.m_reclaimer;
+	other.m_size = 0;
+	other.m_reversed = false;
+	other.m_hasher = nullptr;
+	other.m_reclaimer = nullptr;
+
+	return *this;
+}
+
+template<class T>
+safelist<T>& safelist<T>::operator=(std::initializer_list<value_type> ilist)
+{
+	assign(ilist);
 
 	return *this;
 }
 
+template<class T>
+void safelist<T>::assign(size_type count, const value_type& value)
+{
+	auto it = begin();
+	const auto last = end();
+	for (; it != last && count > 0; ++it, --count) {
+		*it = value;
+	}
+
+	if (count > 0) {
+		insert(last, count, value);
+	} else {
+		erase(it, last);
+	}
+
+	if (m_hasher) {
+		rehash();
+	}
+}
+
+template<class T>
+template<class InputIt, typename>
+void safelist<T>::assign(InputIt first, InputIt last)
+{
+	auto it = begin();
+	const auto e = end();
+	for (; it != e && first != last; ++it, ++first) {
+		*it = *first;
+	}
+
+	if (first != last) {
+		insert(e, first, last);
+	} else {
+		erase(it, e);
+	}
+
+	if (m_hasher) {
+		rehash();
+	}
+}
+
+template<class T>
+void safelist<T>::assign(std::initializer_list<value_type> ilist)
+{
+	assign(ilist.begin(), ilist.end());
+}
+
 // Sizing functions
 
 template<class T>
 void safelist<T>::clear()
 {
 	m_size = 0;
-	entryPoint->next = entryPoint;
-	entryPoint->prev = entryPoint;
+	reset_hash();
+	if (entryPoint) {
+		auto chain = std::move(entryPoint->next);
+		entryPoint->next = entryPoint;
+		entryPoint->prev = entryPoint;
+
+		// A chain left to the reclaimer keeps the old owner flag, so that
+		// its entries no longer count as ours. Without a new flag it is
+		// freed right away instead.
+		if (m_reclaimer && chain.use_count() == 1) {
+			try {
+				entryPoint->owner = std::make_shared<bool>(m_reversed);
+			} catch (...) {
+				release_chain(std::move(chain));
+			}
+		}
+		release(std::move(chain));
+	}
+	set_reversed(false);
 }
 
 template<class T>
@@ -421,42 +879,40 @@ bool safelist<T>::empty() const
 template<class T>
 T& safelist<T>::front()
 {
-	return *entryPoint->next->value;
+	return *next_of(entryPoint)->value;
 }
 
 template<class T>
 const T& safelist<T>::front() const
 {
-	return *entryPoint->next->value;
+	return *next_of(entryPoint)->value;
 }
 
 template<class T>
 T& safelist<T>::back()
 {
-	return *entryPoint->prev.lock()->value;
+	return *prev_of(entryPoint)->value;
 }
 
 template<class T>
 const T& safelist<T>::back() const
 {
-	return *entryPoint->prev.lock()->value;
+	return *prev_of(entryPoint)->value;
 }
 
 // Element creation
 template<class T>
 void safelist<T>::push_front(const T& value)
 {
-	entryPoint->next = std::make_shared<entry>(value, entryPoint->next, entryPoint);
-	entryPoint->next->next->prev = entryPoint->next;
+	auto& head = sentinel();
+	insert_entry(next_of(head), make_entry(value));
 	++m_size;
 }
 
 template<class T>
 void safelist<T>::push_back(const T& value)
 {
-	auto tmpShared = entryPoint->prev.lock();
-
-	entryPoint->prev = tmpShared->next = std::make_shared<entry>(value, entryPoint, entryPoint->prev);
+	insert_entry(sentinel(), make_entry(value));
 	++m_size;
 }
 
@@ -464,26 +920,115 @@ template<class T>
 typename safelist<T>::iterator safelist<T>::erase(const_iterator pos)
 {
 	auto e = pos.item.lock();
-	if (!e->value) {
+	if (!e || !e->value) {
 		throw std::range_error("Unable to erase end()");
 	}
+	check_member(*e);
 
 	auto p = std::const_pointer_cast<entry>(e);
+	auto next = next_of(p);
 
-	p->prev.lock()->next = p->next;
-	p->next->prev = p->prev;
-
+	unlink_entry(p);
 	--m_size;
 
-	return iterator(p->next);
+	return iterator(next);
 }
 
 template<class T>
 typename safelist<T>::iterator safelist<T>::erase(const_iterator first, const_iterator last)
 {
-	for (; first != last; erase(first++));
+	if (!m_reclaimer) {
+		for (; first != last; erase(first++));
+
+		return iterator(last);
+	}
+
+	auto f = iterator_entry(first), l = iterator_entry(last);
+	if (f == l) {
+		return iterator(last);
+	}
+	if (!f || !l) {
+		throw std::range_error("Unable to erase end()");
+	}
+	check_member(*f);
+	check_member(*l);
+
+	// Count the range before changing anything.
+	auto prev = prev_of(f);
+	size_type count = 0;
+	for (auto e = f; e != l; e = next_of(e)) {
+		if (!e->value) {
+			throw std::range_error("Unable to erase end()");
+		}
+		++count;
+	}
+
+	if (m_hasher) {
+		std::uint64_t hash[2] = {};
+		for (auto e = f; e != l; e = next_of(e)) {
+			const auto p = element_hash(prev_of(e)), v = element_hash(e);
+			hash[0] += pair_hash(p, v);
+			hash[1] += pair_hash(v, p);
+		}
+
+		const auto p = element_hash(prev_of(l)), n = element_hash(l);
+		m_hash[0] -= hash[0];
+		m_hash[1] -= hash[1];
+		hash_unlink(p, n);
+		hash_link(element_hash(prev), n);
+	}
+
+	// The range keeps its own links, so that iterators into it can move
+	// on. Its entries own each other in the direction of next, which runs
+	// backwards through the range in a reversed list. The chain must be
+	// the only reference to its head to be handed over.
+	for (auto e = f; e != l; e = next_of(e)) {
+		e->owner = detached(m_reversed);
+	}
+	auto chain = m_reversed ? l->next : f;
+	link(prev, l);
+	f.reset();
+	m_size -= count;
+	release(std::move(chain));
+
+	return iterator(last);
+}
+
+template<class T>
+typename safelist<T>::node_type safelist<T>::extract(const_iterator pos)
+{
+	auto e = iterator_entry(pos);
+	if (!e || !e->value) {
+		throw std::range_error("Unable to extract end()");
+	}
+	check_member(*e);
+
+	unlink_entry(e);
+	--m_size;
+
+	// Unlike an erased entry, the handle outlives the list, so it must
+	// not keep the neighbours, or the list's owner flag, alive.
+	e->next.reset();
+	e->prev.reset();
+	e->owner.reset();
+
+	return node_type(std::move(e));
+}
+
+template<class T>
+typename safelist<T>::iterator safelist<T>::insert(const_iterator pos, node_type&& node)
+{
+	if (node.empty()) {
+		return iterator(pos);
+	}
 
-	return last;
+	// The handle keeps the element if pos is no position in a list.
+	auto before = position_entry(pos);
+	auto e = std::move(node.item);
+	insert_entry(before, e);
+	++m_size;
+
+	return iterator(e);
 }
 
 // Element deletion
@@ -491,8 +1036,7 @@ template<class T>
 void safelist<T>::pop_front()
 {
 	if (m_size) {
-		entryPoint->next = entryPoint->next->next;
-		entryPoint->next->prev = entryPoint;
+		unlink_entry(next_of(entryPoint));
 		--m_size;
 	}
 }
@@ -501,9 +1045,7 @@ template<class T>
 void safelist<T>::pop_back()
 {
 	if (m_size) {
-		auto tempShared = entryPoint->prev.lock()->prev.lock();
-		entryPoint->prev = tempShared;
-		tempShared->next = entryPoint;
+		unlink_entry(prev_of(entryPoint));
 		--m_size;
 	}
 }
@@ -513,12 +1055,12 @@ template<class T>
 template<class... Args>
 typename safelist<T>::iterator safelist<T>::emplace(const_iterator pos, Args&&... args)
 {
-	auto realPos = std::const_pointer_cast<entry>((--pos).item.lock());
-	realPos->next->next->prev = realPos->next = std::make_shared<entry>(std::make_unique<value_type>(args...), realPos->next, realPos);
+	auto e = make_entry(std::make_unique<value_type>(std::forward<Args>(args)...));
+	insert_entry(position_entry(pos), e);
 
 	++m_size;
 
-	return iterator(realPos->next);
+	return iterator(e);
 }
 
 
@@ -526,7 +1068,8 @@ template<class T>
 template<class... Args>
 void safelist<T>::emplace_back(Args&&... args)
 {
-	emplace(end(), args...);
+	insert_entry(sentinel(), make_entry(std::make_unique<value_type>(std::forward<Args>(args)...)));
+	++m_size;
 }
 
 
@@ -534,32 +1077,38 @@ template<class T>
 template<class... Args>
 void safelist<T>::emplace_front(Args&&... args)
 {
-	emplace(++begin(), args...);
+	auto& head = sentinel();
+	insert_entry(next_of(head), make_entry(std::make_unique<value_type>(std::forward<Args>(args)...)));
+	++m_size;
 }
 
 // Iterator creation
+// Mutable iterators create the sentinel so that end() stays valid once
+// elements are added. A const list without one yields null iterators, which
+// compare equal to each other.
 template<class T>
 typename safelist<T>::iterator safelist<T>::begin()
 {
-	return iterator(entryPoint->next);
+	auto& head = sentinel();
+	return iterator(next_of(head));
 }
 
 template<class T>
 typename safelist<T>::iterator safelist<T>::end()
 {
-	return iterator(entryPoint);
+	return iterator(sentinel());
 }
 
 template<class T>
 typename safelist<T>::const_iterator safelist<T>::begin() const
 {
-	return const_iterator(entryPoint->next);
+	return entryPoint ? const_iterator(next_of(entryPoint)) : const_iterator();
 }
 
 template<class T>
 typename safelist<T>::const_iterator safelist<T>::end() const
 {
-	return const_iterator(entryPoint);
+	return entryPoint ? const_iterator(entryPoint) : const_iterator();
 }
 
 template<class T>
@@ -602,7 +1151,7 @@ typename safelist<T>::iterator safelist<T>::insert(const_iterator pos, value_typ
 template<class T>
 typename safelist<T>::iterator safelist<T>::insert(const_iterator pos, size_type count, const value_type& value)
 {
-	iterator retval = pos;
+	iterator retval(pos);
 	for (; count > 0; --count) {
 		retval = emplace(retval, value);
 	}
@@ -614,9 +1163,13 @@ template<class T>
 template<class InputIt, typename>
 typename safelist<T>::iterator safelist<T>::insert(const_iterator pos, InputIt first, InputIt last)
 {
-	iterator retval = pos;
-	for (; first != last; ++first) {
-		retval = emplace(retval, *first);
+	if (first == last) {
+		return iterator(pos);
+	}
+
+	iterator retval = emplace(pos, *first);
+	for (++first; first != last; ++first) {
+		emplace(pos, *first);
 	}
 
 	return retval;
@@ -638,13 +1191,13 @@ bool safelist<T>::operator<(const safelist& other) const
 template<class T>
 bool safelist<T>::operator<=(const safelist& other) const
 {
-	return std::lexicographical_compare(begin(), end(), other.begin(), other.end(), std::less_equal<value_type>());
+	return !(other < *this);
 }
 
 template<class T>
 bool safelist<T>::operator>=(const safelist& other) const
 {
-	return std::lexicographical_compare(begin(), end(), other.begin(), other.end(), std::greater_equal<value_type>());
+	return !(*this < other);
 }
 
 template<class T>
@@ -660,7 +1213,16 @@ bool safelist<T>::operator==(const safelist& other) const
 		return false;
 	}
 
-	for (auto it1 = begin(), it2 = begin(); it1 != end(); ++it1, ++it2) {
+	if (m_hasher && m_hasher == other.m_hasher) {
+		if (m_hash[0] != other.m_hash[0]) {
+			return false;
+		}
+		if (m_ordered_valid && other.m_ordered_valid && m_ordered != other.m_ordered) {
+			return false;
+		}
+	}
+
+	for (auto it1 = begin(), it2 = other.begin(); it1 != end(); ++it1, ++it2) {
 		if (*it1 != *it2) {
 			return false;
 		}
@@ -683,18 +1245,182 @@ void safelist<T>::sort(Compare compare)
 		return; // Already sorted.
 	}
 
-	const auto dist = size() / 2;
+	normalize();
+
+	// Bottom-up natural merge sort on the detached chain. The chain is cut
+	// into the runs already in it, and bins[i] holds 2^i of those runs
+	// merged, older elements in higher bins. Sorted input is a single run,
+	// and no temporary lists (or allocations) are needed.
+	std::shared_ptr<entry> bins[std::numeric_limits<size_type>::digits];
+	std::shared_ptr<entry> carry, sorted;
+	auto node = detach_chain();
+
+	try {
+		while (node) {
+			carry = std::move(node);
+			node = std::move(carry->next);
+
+			if (node && compare(*node->value, *carry->value)) {
+				// Strictly descending runs are reversed, which keeps them stable.
+				while (node && compare(*node->value, *carry->value)) {
+					auto next = std::move(node->next);
+					node->next = std::move(carry);
+					carry = std::move(node);
+					node = std::move(next);
+				}
+			} else {
+				auto last = carry.get();
+				last->next = std::move(node);
+				while (last->next && !compare(*last->next->value, *last->value)) {
+					last = last->next.get();
+				}
+				node = std::move(last->next);
+			}
+
+			std::size_t i = 0;
+			for (; bins[i]; ++i) {
+				merge_chains(bins[i], carry, compare);
+				carry = std::move(bins[i]);
+			}
+			bins[i] = std::move(carry);
+		}
 
-	safelist other;
-	auto it = begin();
-	std::advance(it, dist);
+		for (auto& bin : bins) {
+			if (bin) {
+				merge_chains(bin, sorted, compare);
+				sorted = std::move(bin);
+			}
+		}
+	} catch (...) {
+		// Keep every element, in whatever order the pieces are in.
+		auto tail = &node;
+		for (auto& bin : bins) {
+			while (*tail) {
+				tail = &(*tail)->next;
+			}
+			*tail = std::move(bin);
+		}
+		for (auto chain : {&carry, &sorted}) {
+			while (*tail) {
+				tail = &(*tail)->next;
+			}
+			*tail = std::move(*chain);
+		}
+
+		attach_chain(std::move(node));
+		throw;
+	}
+
+	attach_chain(std::move(sorted));
+}
+
+template<class T>
+template<class KeyFunction>
+void safelist<T>::sort_by_key(KeyFunction key)
+{
+	if (size() < 2) {
+		return; // Already sorted.
+	}
+
+	normalize();
+
+	typedef typename std::decay<decltype(key(std::declval<const value_type&>()))>::type key_type;
+
+	// Extract (key, position) pairs into one contiguous buffer, so the sort
+	// itself never touches the entries.
+	std::vector<std::shared_ptr<entry>> nodes;
+	std::vector<std::pair<key_type, size_type>> keys;
+	nodes.reserve(size());
+	keys.reserve(size());
+
+	auto node = detach_chain();
+	try {
+		while (node) {
+			keys.emplace_back(key(*node->value), nodes.size());
+			// Drop the prev link while its target is still in cache.
+			node->prev.reset();
+			auto next = std::move(node->next);
+			nodes.push_back(std::move(node));
+			node = std::move(next);
+		}
+
+		sort_keys(keys, is_radix_key<key_type>());
+	} catch (...) {
+		// Put everything back in the original order.
+		for (auto n = nodes.rbegin(); n != nodes.rend(); ++n) {
+			(*n)->next = std::move(node);
+			node = std::move(*n);
+		}
 
-	other.splice(other.end(), *this, begin(), it);
+		attach_chain(std::move(node));
+		throw;
+	}
+
+	// Relink in sorted order, fixing the prev links in the same sweep.
+	auto tail = &entryPoint;
+	for (auto& k : keys) {
+		(*tail)->next = std::move(nodes[k.second]);
+		(*tail)->next->prev = *tail;
+		tail = &(*tail)->next;
+	}
+
+	(*tail)->next = entryPoint;
+	entryPoint->prev = *tail;
+
+	if (m_hasher) {
+		rehash();
+	}
+}
+
+// LSD radix sort, one byte per pass. Signed keys get their sign bit flipped
+// so that they order correctly as unsigned.
+template<class T>
+template<class Key>
+void safelist<T>::sort_keys(std::vector<std::pair<Key, size_type>>& keys, std::true_type)
+{
+	typedef typename std::make_unsigned<Key>::type radix_type;
+	const int bits = std::numeric_limits<radix_type>::digits;
+	const radix_type flip = std::is_signed<Key>::value ? radix_type(1) << (bits - 1) : 0;
+
+	auto digit = [flip](const std::pair<Key, size_type>& k, int shift) {
+		return ((static_cast<radix_type>(k.first) ^ flip) >> shift) & 0xff;
+	};
+
+	std::vector<std::pair<Key, size_type>> buffer(keys.size());
+	for (int shift = 0; shift < bits; shift += 8) {
+		size_type offsets[256] = {};
+		for (auto& k : keys) {
+			++offsets[digit(k, shift)];
+		}
+
+		// Nothing to do if every key has the same digit here.
+		if (std::find(std::begin(offsets), std::end(offsets), keys.size()) != std::end(offsets)) {
+			continue;
+		}
+
+		size_type total = 0;
+		for (auto& offset : offsets) {
+			const auto count = offset;
+			offset = total;
+			total += count;
+		}
+
+		for (auto& k : keys) {
+			buffer[offsets[digit(k, shift)]++] = k;
+		}
 
-	sort(compare);
-	other.sort(compare);
+		keys.swap(buffer);
+	}
+}
 
-	merge(other, compare);
+template<class T>
+template<class Key>
+void safelist<T>::sort_keys(std::vector<std::pair<Key, size_type>>& keys, std::false_type)
+{
+	std::stable_sort(keys.begin(), keys.end(),
+		[](const std::pair<Key, size_type>& a, const std::pair<Key, size_type>& b) {
+			return a.first < b.first;
+		});
 }
 
 template<class T>
@@ -720,65 +1446,63 @@ void safelist<T>::unique(BinaryPredicate pred)
 }
 
 template<class T>
-template<class Compare>
-void safelist<T>::merge(safelist& other, Compare comp)
+template<class Hash, class KeyEqual>
+void safelist<T>::unique_unordered(Hash hash, KeyEqual eq)
 {
-	if (&other == this) {
-		// Invalid operation.
-		return;
-	}
+	value_set<Hash, KeyEqual> seen(size(), indirect_hash<Hash>{hash}, indirect_equal<KeyEqual>{eq});
 
-	auto selfIt = entryPoint;
-	auto otherIt = other.entryPoint->next;
-
-	while (otherIt != other.entryPoint) {
-		auto selfNext = selfIt->next;
-		auto otherNext = otherIt->next;
-
-		if (selfIt->next == entryPoint || !comp(*selfNext->value, *otherIt->value)) {
-			entryPoint->prev = selfIt->next = otherIt;
-			selfNext->prev = selfIt->next = otherIt;
-			otherIt->prev = selfIt;
-			otherIt->next = std::move(selfNext);
-			otherIt = std::move(otherNext);
+	auto it = cbegin();
+	const auto eIt = cend();
+	while (it != eIt) {
+		if (seen.insert(&*it).second) {
+			++it;
 		} else {
-			selfIt = std::move(selfNext);
+			erase(it++);
 		}
 	}
-
-	m_size += other.m_size;
-	other.m_size = 0;
-
-	other.entryPoint->prev = other.entryPoint->next = other.entryPoint;
 }
 
 template<class T>
-void safelist<T>::reverse()
+template<class Hash, class KeyEqual>
+void safelist<T>::difference_with(const safelist& other, Hash hash, KeyEqual eq)
 {
-	auto it = begin();
-	auto rIt = end();
-
-	for (auto iters = size() / 2; iters > 0; --iters) {
-		std::swap((it++).item.lock()->value, (--rIt).item.lock()->value);
+	if (&other == this) {
+		clear();
+	} else if (!empty() && !other.empty()) {
+		filter(value_index(other, hash, eq), false);
 	}
 }
 
 template<class T>
-void safelist<T>::remove(const value_type& value)
+template<class Hash, class KeyEqual>
+void safelist<T>::intersect_with(const safelist& other, Hash hash, KeyEqual eq)
 {
-	using namespace std::placeholders;
-
-	return remove_if(std::bind(std::equal_to<value_type>(), _1, value));
+	if (&other == this || empty()) {
+		return;
+	} else if (other.empty()) {
+		clear();
+	} else {
+		filter(value_index(other, hash, eq), true);
+	}
 }
 
 template<class T>
-template<class UnaryPredicate>
-void safelist<T>::remove_if(UnaryPredicate pred)
+template<class Hash, class KeyEqual>
+void safelist<T>::union_with(safelist& other, Hash hash, KeyEqual eq)
 {
-	auto it = begin();
-	while (it != end()) {
-		if (pred(*it)) {
-			erase(it++);
+	if (&other == this || other.empty()) {
+		return;
+	}
+
+	// Elements moved over join the index, so that their duplicates in
+	// other stay behind.
+	auto seen = value_index(*this, hash, eq);
+	const auto pos = end();
+	auto it = other.cbegin();
+	const auto eIt = other.cend();
+	while (it != eIt) {
+		if (seen.insert(&*it).second) {
+			splice(pos, other, it++);
 		} else {
 			++it;
 		}
@@ -786,34 +1510,877 @@ void safelist<T>::remove_if(UnaryPredicate pred)
 }
 
 template<class T>
-std::shared_ptr<typename safelist<T>::entry> safelist<T>::iterator_entry(const_iterator& it)
+template<class Hash, class KeyEqual>
+typename safelist<T>::template value_set<Hash, KeyEqual> safelist<T>::value_index(const safelist& l, Hash& hash, KeyEqual& eq)
 {
-	return std::const_pointer_cast<entry>(it.item.lock());
+	value_set<Hash, KeyEqual> values(l.size(), indirect_hash<Hash>{hash}, indirect_equal<KeyEqual>{eq});
+	for (auto& v : l) {
+		values.insert(&v);
+	}
+
+	return values;
 }
 
 template<class T>
-void safelist<T>::splice(const_iterator pos, safelist& other)
+template<class Hash, class KeyEqual>
+void safelist<T>::filter(const value_set<Hash, KeyEqual>& index, bool keep)
 {
-	assert(&other != this);
+	auto it = cbegin();
+	const auto eIt = cend();
+	while (it != eIt) {
+		if ((index.count(&*it) != 0) == keep) {
+			++it;
+		} else {
+			erase(it++);
+		}
+	}
+}
+
+template<class T>
+template<class Compare>
+void safelist<T>::merge(safelist& other, Compare comp)
+{
+	if (&other == this || other.empty()) {
+		// Invalid operation, or nothing to do.
+		return;
+	}
+
+	normalize();
+	other.normalize();
+
+	// Lists that do not interleave are simply spliced together. Equal
+	// elements from this list go first, to keep the merge stable.
+	if (empty() || !comp(*other.entryPoint->next->value, *entryPoint->prev.lock()->value)) {
+		splice(end(), other);
+		return;
+	}
+	if (comp(*other.entryPoint->prev.lock()->value, *entryPoint->next->value)) {
+		splice(begin(), other);
+		return;
+	}
+
+	// Otherwise alternate between runs from both lists, moving each run of
+	// other's elements in one go. Only the entries at the ends of a run
+	// get new links.
+	const std::weak_ptr<entry> otherTail = other.entryPoint->prev;
+	auto chain = other.detach_chain();
+	adopt(chain.get(), nullptr);
+	m_size += other.m_size;
+	other.m_size = 0;
+
+	const entry* const head = entryPoint.get();
+	entry* pos = entryPoint.get();
+	try {
+		while (chain) {
+			auto& first = *chain->value;
+			if (pos->next.get() != head && !comp(first, *pos->next->value)) {
+				pos = run_end(pos->next.get(), head, [&](const value_type& v) { return !comp(first, v); });
+			}
+
+			auto next = pos->next.get();
+			auto last = next == head
+				? otherTail.lock().get()
+				: run_end(chain.get(), nullptr, [&](const value_type& v) { return comp(v, *next->value); });
+
+			auto rest = std::move(last->next);
+			chain->prev = next->prev;
+			next->prev = rest ? rest->prev : otherTail;
+			last->next = std::move(pos->next);
+			pos->next = std::move(chain);
+			pos = last;
+			chain = std::move(rest);
+		}
+	} catch (...) {
+		// Keep the remaining elements, at the end.
+		if (chain) {
+			auto tail = otherTail.lock();
+			chain->prev = entryPoint->prev;
+			entryPoint->prev.lock()->next = std::move(chain);
+			entryPoint->prev = tail;
+			tail->next = entryPoint;
+		}
+		other.reset_hash();
+		if (m_hasher) {
+			rehash();
+		}
+		throw;
+	}
+
+	other.reset_hash();
+	if (m_hasher) {
+		rehash();
+	}
+}
+
+template<class T>
+template<class Range, class Compare>
+void safelist<T>::merge_all(Range&& lists, Compare comp)
+{
+	// Read position in one of the input chains.
+	struct cursor
+	{
+		std::shared_ptr<entry> node;
+		std::shared_ptr<entry> end;
+		std::size_t source;
+	};
+
+	std::vector<cursor> heads;
+	heads.reserve(std::distance(std::begin(lists), std::end(lists)) + 1);
+	std::size_t source = 0;
+
+	// Detach our own chain first, so that it takes part as the first input.
+	normalize();
+	if (!empty()) {
+		heads.push_back({entryPoint->next, entryPoint, source});
+	}
+	sentinel();
+	size_type total = m_size;
+
+	for (auto& other : lists) {
+		++source;
+		if (&other == this || other.empty()) {
+			continue;
+		}
+
+		other.normalize();
+		heads.push_back({other.entryPoint->next, other.entryPoint, source});
+		total += other.m_size;
+	}
+
+	clear();
+	for (auto& other : lists) {
+		if (&other != this) {
+			other.clear();
+		}
+	}
+
+	// Min-heap on the head values; ties go to the earliest list. The heap
+	// algorithms may lose an element if the comparison throws, so an
+	// exception from comp is held until the heap is left alone.
+	std::exception_ptr failure;
+	auto later = [&comp, &failure](const cursor& a, const cursor& b) {
+		if (failure) {
+			return false;
+		}
+
+		try {
+			if (comp(*b.node->value, *a.node->value)) {
+				return true;
+			}
+
+			return !comp(*a.node->value, *b.node->value) && a.source > b.source;
+		} catch (...) {
+			failure = std::current_exception();
+			return false;
+		}
+	};
+	std::make_heap(heads.begin(), heads.end(), later);
+
+	auto tail = entryPoint;
+	while (!failure && !heads.empty()) {
+		std::pop_heap(heads.begin(), heads.end(), later);
+		if (failure) {
+			break;
+		}
+		auto& head = heads.back();
+
+		auto next = head.node->next;
+		tail->next = head.node;
+		head.node->prev = tail;
+		head.node->owner = entryPoint->owner;
+		tail = std::move(head.node);
+
+		if (next != head.end) {
+			head.node = std::move(next);
+			std::push_heap(heads.begin(), heads.end(), later);
+		} else {
+			heads.pop_back();
+		}
+	}
+
+	if (failure) {
+		// Keep the unmerged runs after the merged part.
+		for (auto& head : heads) {
+			tail->next = std::move(head.node);
+			while (tail->next != head.end) {
+				tail = tail->next;
+				tail->owner = entryPoint->owner;
+			}
+		}
+
+		tail->next = nullptr;
+		auto chain = std::move(entryPoint->next);
+		entryPoint->next = entryPoint;
+		m_size = total;
+		attach_chain(std::move(chain));
+		std::rethrow_exception(failure);
+	}
+
+	tail->next = entryPoint;
+	entryPoint->prev = tail;
+	m_size = total;
+
+	if (m_hasher) {
+		rehash();
+	}
+}
+
+template<class T>
+void safelist<T>::reverse()
+{
+	set_reversed(!m_reversed);
+	std::swap(m_hash[0], m_hash[1]);
+	m_ordered_valid = false;
+}
+
+template<class T>
+void safelist<T>::normalize()
+{
+	if (!m_reversed) {
+		return;
+	}
+
+	set_reversed(false);
+	if (!entryPoint) {
+		return;
+	}
+
+	// Swap next and prev on every entry, the sentinel included. Each entry
+	// is held until its successor has taken ownership of it.
+	std::shared_ptr<entry> held;
+	auto node = entryPoint;
+	do {
+		auto next = std::move(node->next);
+		node->next = node->prev.lock();
+		node->prev = next;
+		held = std::move(node);
+		node = std::move(next);
+	} while (node != entryPoint);
+}
+
+template<class T>
+void safelist<T>::remove(const value_type& value)
+{
+	using namespace std::placeholders;
+
+	return remove_if(std::bind(std::equal_to<value_type>(), _1, value));
+}
+
+template<class T>
+template<class UnaryPredicate>
+void safelist<T>::remove_if(UnaryPredicate pred)
+{
+	if (empty()) {
+		return;
+	}
+
+	auto it = begin();
+	while (it != end()) {
+		if (pred(*it)) {
+			erase(it++);
+		} else {
+			++it;
+		}
+	}
+}
+
+template<class T>
+typename safelist<T>::layout_stats safelist<T>::layout() const
+{
+	// Entries further apart than this are unlikely to share a cache line
+	// or a prefetch.
+	const std::ptrdiff_t near = 256;
+
+	layout_stats stats = {0, 0};
+	if (size() < 2) {
+		return stats;
+	}
+
+	auto node = next_of(entryPoint);
+	for (auto next = next_of(node); next != entryPoint; node = std::move(next), next = next_of(node)) {
+		const auto distance = reinterpret_cast<const char*>(next.get()) - reinterpret_cast<const char*>(node.get());
+		++stats.links;
+		if (distance > near || distance < -near) {
+			++stats.far_links;
+		}
+	}
+
+	return stats;
+}
+
+template<class T>
+void safelist<T>::defragment()
+{
+	if (empty()) {
+		return;
+	}
+
+	normalize();
+	entry_arena arena(m_size);
+
+	// The control blocks come from the heap, so that stale iterators do
+	// not pin the block. Those allocations can fail, so the new entries
+	// are all made before the list is taken apart.
+	std::shared_ptr<entry> head;
+	auto tail = &head;
+	try {
+		for (size_type i = 0; i < m_size; ++i) {
+			*tail = std::shared_ptr<entry>(new (arena.allocate(sizeof(entry))) entry(), arena_delete());
+			tail = &(*tail)->next;
+		}
+	} catch (...) {
+		release_chain(std::move(head));
+		throw;
+	}
+
+	auto node = detach_chain();
+	for (auto e = head.get(); node; e = e->next.get()) {
+		e->value = std::move(node->value);
+		e->owner = std::move(node->owner);
+		auto next = std::move(node->next);
+		node = std::move(next);
+	}
+
+	attach_chain(std::move(head));
+}
+
+template<class T>
+safelist<T>::entry_arena::~entry_arena()
+{
+	if (m_block) {
+		release(m_block);
+	}
+}
+
+template<class T>
+void* safelist<T>::entry_arena::allocate(std::size_t bytes)
+{
+	const auto slot = header + padded(bytes);
+	if (!m_block) {
+		m_used = padded(sizeof(block));
+		m_capacity = m_used + m_count * slot;
+		m_block = static_cast<block*>(::operator new(m_capacity));
+		m_block->live = 1; // Held by the arena itself until it is done.
+	}
+
+	char* p;
+	if (m_used + slot <= m_capacity) {
+		p = reinterpret_cast<char*>(m_block) + m_used;
+		m_used += slot;
+		*reinterpret_cast<block**>(p) = m_block;
+		++m_block->live;
+	} else {
+		// More requests than expected; fall back to the heap.
+		p = static_cast<char*>(::operator new(slot));
+		*reinterpret_cast<block**>(p) = nullptr;
+	}
+
+	return p + header;
+}
+
+template<class T>
+void safelist<T>::entry_arena::deallocate(void* p)
+{
+	auto start = static_cast<char*>(p) - header;
+	if (auto b = *reinterpret_cast<block**>(start)) {
+		release(b);
+	} else {
+		::operator delete(start);
+	}
+}
+
+template<class T>
+void safelist<T>::entry_arena::release(block* b)
+{
+	if (--b->live == 0) {
+		::operator delete(b);
+	}
+}
+
+template<class T>
+template<class Hash>
+void safelist<T>::enable_hash()
+{
+	m_hasher = &hash_value<Hash>;
+	rehash();
+}
+
+template<class T>
+void safelist<T>::disable_hash()
+{
+	m_hasher = nullptr;
+}
+
+template<class T>
+std::size_t safelist<T>::hash() const
+{
+	if (!m_hasher) {
+		throw std::logic_error("Hashing is not enabled");
+	}
+
+	if (!m_ordered_valid) {
+		auto h = element_hash(nullptr);
+		for (const auto& v : *this) {
+			h = pair_hash(h, m_hasher(v));
+		}
+		m_ordered = h;
+		m_ordered_valid = true;
+	}
+
+	return static_cast<std::size_t>(m_ordered);
+}
+
+template<class T>
+void safelist<T>::rehash()
+{
+	if (!m_hasher || empty()) {
+		reset_hash();
+		return;
+	}
+
+	m_hash[0] = m_hash[1] = 0;
+	auto prev = entryPoint;
+	auto prevHash = element_hash(prev);
+	do {
+		auto next = next_of(prev);
+		const auto nextHash = element_hash(next);
+		hash_link(prevHash, nextHash);
+		prev = std::move(next);
+		prevHash = nextHash;
+	} while (prev != entryPoint);
+}
+
+// Sets the hash to that of an empty list, whose only pair is the sentinel
+// next to itself.
+template<class T>
+void safelist<T>::reset_hash()
+{
+	m_hash[0] = m_hash[1] = 0;
+	m_ordered_valid = false;
+	if (m_hasher) {
+		const auto s = element_hash(nullptr);
+		hash_link(s, s);
+	}
+}
+
+template<class T>
+std::uint64_t safelist<T>::element_hash(const std::shared_ptr<entry>& e) const
+{
+	// The sentinel gets a fixed value.
+	return e && e->value ? m_hasher(*e->value) : 0x6a09e667f3bcc909;
+}
+
+// Mixes both hashes with the splitmix64 finaliser. Mixing the second one
+// separately makes the result depend on the order.
+template<class T>
+std::uint64_t safelist<T>::pair_hash(std::uint64_t first, std::uint64_t second)
+{
+	auto mix = [](std::uint64_t x) {
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111eb;
+		return x ^ (x >> 31);
+	};
+
+	return mix(first + mix(second ^ 0x9e3779b97f4a7c15));
+}
+
+template<class T>
+void safelist<T>::hash_link(std::uint64_t first, std::uint64_t second)
+{
+	m_hash[0] += pair_hash(first, second);
+	m_hash[1] += pair_hash(second, first);
+	m_ordered_valid = false;
+}
+
+template<class T>
+void safelist<T>::hash_unlink(std::uint64_t first, std::uint64_t second)
+{
+	m_hash[0] -= pair_hash(first, second);
+	m_hash[1] -= pair_hash(second, first);
+	m_ordered_valid = false;
+}
+
+template<class T>
+template<class... Args>
+std::shared_ptr<typename safelist<T>::entry> safelist<T>::make_entry(Args&&... args)
+{
+	return std::shared_ptr<entry>(new entry(std::forward<Args>(args)...));
+}
+
+template<class T>
+const std::shared_ptr<typename safelist<T>::entry>& safelist<T>::sentinel()
+{
+	if (!entryPoint) {
+		auto s = new sentinel_entry();
+		entryPoint.reset(s);
+		s->reversed = m_reversed;
+		s->owner = typename entry::owner_ptr_t(entryPoint, &s->reversed);
+		entryPoint->next = entryPoint;
+		entryPoint->prev = entryPoint;
+	}
+
+	return entryPoint;
+}
+
+template<class T>
+void safelist<T>::set_reversed(bool reversed)
+{
+	m_reversed = reversed;
+	if (entryPoint) {
+		*entryPoint->owner = reversed;
+	}
+}
+
+// Drops the sentinel, after handing over the entries. The sentinel may
+// outlive the list, through entries or chains that still refer to it.
+template<class T>
+void safelist<T>::release_sentinel() noexcept
+{
+	if (entryPoint) {
+		release(std::move(entryPoint->next));
+		entryPoint->owner.reset();
+		entryPoint.reset();
+	}
+}
+
+// Makes the entries from first up to last, in the direction of next,
+// belong to this list.
+template<class T>
+void safelist<T>::adopt(entry* first, const entry* last)
+{
+	for (; first != last; first = first->next.get()) {
+		first->owner = entryPoint->owner;
+	}
+}
+
+// The flags only alias an empty owner, so they are never freed, and no
+// list writes to them.
+template<class T>
+const typename safelist<T>::entry::owner_ptr_t& safelist<T>::detached(bool reversed)
+{
+	static bool flags[] = {false, true};
+	static const typename entry::owner_ptr_t owners[] = {
+		typename entry::owner_ptr_t(typename entry::owner_ptr_t(), &flags[0]),
+		typename entry::owner_ptr_t(typename entry::owner_ptr_t(), &flags[1])
+	};
+
+	return owners[reversed];
+}
+
+// Entries that were extracted, erased or left to the reclaimer are
+// rejected, even though the latter two still have their links.
+template<class T>
+void safelist<T>::check_member(const entry& e) const
+{
+	if (!e.next) {
+		throw std::range_error("Iterator points to an extracted element");
+	}
+	if (!entryPoint || e.owner != entryPoint->owner) {
+		throw std::range_error("Iterator does not point into this list");
+	}
+}
+
+template<class T>
+std::shared_ptr<typename safelist<T>::entry> safelist<T>::iterator_entry(const_iterator& it)
+{
+	return std::const_pointer_cast<entry>(it.item.lock());
+}
+
+template<class T>
+std::shared_ptr<typename safelist<T>::entry> safelist<T>::next_of(const std::shared_ptr<entry>& e) const
+{
+	return m_reversed ? e->prev.lock() : e->next;
+}
+
+template<class T>
+std::shared_ptr<typename safelist<T>::entry> safelist<T>::prev_of(const std::shared_ptr<entry>& e) const
+{
+	return m_reversed ? e->next : e->prev.lock();
+}
+
+// Makes second follow first in the list's current orientation.
+template<class T>
+void safelist<T>::link(const std::shared_ptr<entry>& first, const std::shared_ptr<entry>& second)
+{
+	if (m_reversed) {
+		second->next = first;
+		first->prev = second;
+	} else {
+		first->next = second;
+		second->prev = first;
+	}
+}
+
+// Both expect the caller to hold the entries passed in, as relinking may
+// drop the list's own references to them.
+template<class T>
+void safelist<T>::insert_entry(const std::shared_ptr<entry>& pos, const std::shared_ptr<entry>& e)
+{
+	auto prev = prev_of(pos);
+	if (m_hasher) {
+		const auto p = element_hash(prev), n = element_hash(pos), v = element_hash(e);
+		hash_unlink(p, n);
+		hash_link(p, v);
+		hash_link(v, n);
+	}
+
+	e->owner = entryPoint->owner;
+	link(prev, e);
+	link(e, pos);
+}
+
+// The entry keeps its own links, so that iterators to it can move on.
+template<class T>
+void safelist<T>::unlink_entry(const std::shared_ptr<entry>& e)
+{
+	auto prev = prev_of(e);
+	auto next = next_of(e);
+	if (m_hasher) {
+		const auto p = element_hash(prev), n = element_hash(next), v = element_hash(e);
+		hash_unlink(p, v);
+		hash_unlink(v, n);
+		hash_link(p, n);
+	}
+
+	link(prev, next);
+	e->owner = detached(m_reversed);
+}
+
+template<class T>
+void safelist<T>::release(std::shared_ptr<entry> chain) noexcept
+{
+	// A chain still referenced elsewhere, like one spliced into another
+	// list, is not ours to free.
+	if (m_reclaimer && chain.use_count() == 1) {
+		try {
+			m_reclaimer->chains.push_back(std::move(chain));
+			return;
+		} catch (...) {
+			// Out of memory to queue it, so free it right away.
+		}
+	}
+
+	release_chain(std::move(chain));
+}
+
+// Frees a detached chain one entry at a time. Simply dropping the first
+// entry would free the rest recursively, one stack frame per element.
+template<class T>
+void safelist<T>::release_chain(std::shared_ptr<entry> chain)
+{
+	// Stop at entries that are still referenced elsewhere, such as the
+	// sentinel or the remainder of another chain.
+	while (chain && chain.use_count() == 1) {
+		auto next = std::move(chain->next);
+		chain = std::move(next);
+	}
+}
+
+// Takes the elements out of the ring as a chain ending in nullptr. The
+// prev links inside the chain are left as they are.
+template<class T>
+std::shared_ptr<typename safelist<T>::entry> safelist<T>::detach_chain()
+{
+	if (empty()) {
+		return nullptr;
+	}
+
+	entryPoint->prev.lock()->next = nullptr;
+	auto chain = std::move(entryPoint->next);
+	entryPoint->next = entryPoint;
+	entryPoint->prev = entryPoint;
+
+	return chain;
+}
+
+// Puts a chain from detach_chain() back into the ring, restoring the prev
+// links. The size is expected not to have changed.
+template<class T>
+void safelist<T>::attach_chain(std::shared_ptr<entry> chain)
+{
+	if (!chain) {
+		return;
+	}
+
+	// Walk the owning links rather than copying shared_ptrs.
+	auto tail = &entryPoint;
+	entryPoint->next = std::move(chain);
+	while ((*tail)->next) {
+		(*tail)->next->prev = *tail;
+		tail = &(*tail)->next;
+	}
+
+	entryPoint->prev = *tail;
+	(*tail)->next = entryPoint;
+
+	if (m_hasher) {
+		rehash();
+	}
+}
+
+// Stable merge of two sorted chains into a, leaving b empty; on ties,
+// elements of a go first. Runs from either chain are moved as a whole. If
+// comp throws, a still holds every element, merged or not.
+template<class T>
+template<class Compare>
+void safelist<T>::merge_chains(std::shared_ptr<entry>& a, std::shared_ptr<entry>& b, Compare& comp)
+{
+	std::shared_ptr<entry> head;
+	auto tail = &head;
+
+	try {
+		while (a && b) {
+			entry* last;
+			if (comp(*b->value, *a->value)) {
+				auto& limit = *a->value;
+				last = run_end(b.get(), nullptr, [&](const value_type& v) { return comp(v, limit); });
+				*tail = std::move(b);
+				b = std::move(last->next);
+			} else {
+				auto& limit = *b->value;
+				last = run_end(a.get(), nullptr, [&](const value_type& v) { return !comp(limit, v); });
+				*tail = std::move(a);
+				a = std::move(last->next);
+			}
+			tail = &last->next;
+		}
+	} catch (...) {
+		*tail = std::move(a);
+		while (*tail) {
+			tail = &(*tail)->next;
+		}
+		*tail = std::move(b);
+		a = std::move(head);
+		throw;
+	}
+
+	*tail = a ? std::move(a) : std::move(b);
+	a = std::move(head);
+}
+
+// Last entry of the run that starts at first and ends before stop (or the
+// end of the chain), where in_run holds for a prefix of the entries and
+// does for first. Gallops: probes 1, 2, 4, ... entries further each time
+// and bisects the stretch where the run ended, so a run of n entries takes
+// O(log n) comparisons. The entries are still walked one by one.
+template<class T>
+template<class InRun>
+typename safelist<T>::entry* safelist<T>::run_end(entry* first, const entry* stop, InRun in_run)
+{
+	entry* last = first;
+	for (size_type step = 1;; step *= 2) {
+		auto probe = last;
+		size_type walked = 0;
+		for (; walked < step && probe->next && probe->next.get() != stop; ++walked) {
+			probe = probe->next.get();
+		}
+
+		if (walked == 0) {
+			return last;
+		}
+
+		if (in_run(*probe->value)) {
+			last = probe;
+			continue;
+		}
+
+		// The run ends somewhere after last, and before probe.
+		size_type in = 0, out = walked;
+		while (out - in > 1) {
+			const auto mid = in + (out - in) / 2;
+			auto e = last;
+			for (auto i = in; i < mid; ++i) {
+				e = e->next.get();
+			}
+
+			if (in_run(*e->value)) {
+				last = e;
+				in = mid;
+			} else {
+				out = mid;
+			}
+		}
+
+		return last;
+	}
+}
+
+// Resolves an insertion position. Before the sentinel exists the only valid
+// position is the (null) end iterator, which maps onto the new sentinel.
+template<class T>
+std::shared_ptr<typename safelist<T>::entry> safelist<T>::position_entry(const_iterator& pos)
+{
+	if (!entryPoint) {
+		return sentinel();
+	}
+
+	auto e = iterator_entry(pos);
+	if (!e) {
+		throw std::range_error("Iterator does not point to an entry");
+	}
+	check_member(*e);
+
+	return e;
+}
+
+template<class T>
+void safelist<T>::splice(const_iterator pos, safelist& other)
+{
+	assert(&other != this);
 	if (other.empty()) {
 		return;
 	}
 
-	auto ownPtr = iterator_entry(pos);
+	// The chain can only be moved as a whole if both lists agree on which
+	// way it runs.
+	if (m_reversed != other.m_reversed) {
+		normalize();
+		other.normalize();
+	}
 
-	// Attach beginning
-	ownPtr->prev.lock()->next = other.entryPoint->next;
-	other.entryPoint->next->prev = ownPtr->prev;
+	auto ownPtr = position_entry(pos);
+	auto before = prev_of(ownPtr);
+	auto first = other.next_of(other.entryPoint);
+	auto last = other.prev_of(other.entryPoint);
+
+	// With the same hash function, other's hash only needs its ends
+	// patched up to be added to ours.
+	const bool patch = m_hasher && m_hasher == other.m_hasher;
+	if (patch) {
+		const auto b = element_hash(before), p = element_hash(ownPtr);
+		const auto f = element_hash(first), l = element_hash(last), s = element_hash(entryPoint);
+		m_hash[0] += other.m_hash[0];
+		m_hash[1] += other.m_hash[1];
+		hash_unlink(s, f);
+		hash_unlink(l, s);
+		hash_unlink(b, p);
+		hash_link(b, f);
+		hash_link(l, p);
+	}
+
+	// The side with fewer entries is retagged. When that is ours, the
+	// lists swap owner flags, so that ours goes along with other's entries.
+	if (m_size < other.m_size) {
+		other.adopt(entryPoint->next.get(), entryPoint.get());
+		std::swap(entryPoint->owner, other.entryPoint->owner);
+	} else {
+		adopt(other.entryPoint->next.get(), other.entryPoint.get());
+	}
 
-	// Attach end
-	ownPtr->prev = other.entryPoint->prev;
-	other.entryPoint->prev.lock()->next = ownPtr;
+	link(before, first);
+	link(last, ownPtr);
 
 	// Transfer size
 	m_size += other.m_size;
 
 	// Clear other
 	other.clear();
+
+	if (m_hasher && !patch) {
+		rehash();
+	}
 }
 
 template<class T>
@@ -823,19 +2390,20 @@ void safelist<T>::splice(const_iterator pos, safelist& other, const_iterator it)
 
 	// Make sure we don't lose our edges.
 	auto otherPtr = iterator_entry(it);
-	auto selfPtr = iterator_entry(pos);
-	auto prevPtr = selfPtr->prev.lock();
-
-	// Cut out from other list
-	otherPtr->next->prev = otherPtr->prev;
-	otherPtr->prev.lock()->next = otherPtr->next;
+	if (!otherPtr) {
+		throw std::range_error("Iterator does not point to an entry");
+	}
+	other.check_member(*otherPtr);
+	auto selfPtr = position_entry(pos);
+	auto prevPtr = prev_of(selfPtr);
 
-	// Reconfigure the other pointer.
-	otherPtr->next = selfPtr;
-	otherPtr->prev = prevPtr;
+	if (otherPtr == selfPtr || otherPtr == prevPtr) {
+		// Moving an element to where it already is.
+		return;
+	}
 
-	// Update own chain
-	selfPtr->prev = prevPtr->next = otherPtr;
+	other.unlink_entry(otherPtr);
+	insert_entry(selfPtr, otherPtr);
 
 	// Update sizes
 	++m_size;
@@ -850,17 +2418,223 @@ void safelist<T>::splice(const_iterator pos, safelist& other, const_iterator fir
 	}
 }
 
+template<class T>
+safelist<T> safelist<T>::split_at(const_iterator pos)
+{
+	safelist tail;
+	tail.m_hasher = m_hasher;
+
+	auto first = iterator_entry(pos);
+	if (!first || first == entryPoint) {
+		tail.reset_hash();
+		return tail;
+	}
+	check_member(*first);
+
+	normalize();
+
+	// Walk away from the cut in both directions until either end is hit.
+	size_type count = 0;
+	const entry* forward = first.get();
+	auto backward = first->prev.lock();
+	while (forward != entryPoint.get() && backward != entryPoint) {
+		forward = forward->next.get();
+		backward = backward->prev.lock();
+		++count;
+	}
+	if (forward != entryPoint.get()) {
+		count = m_size - count;
+	}
+
+	// As in splice(), the shorter side is retagged.
+	tail.sentinel();
+	if (forward == entryPoint.get()) {
+		tail.adopt(first.get(), entryPoint.get());
+	} else {
+		tail.adopt(entryPoint->next.get(), first.get());
+		std::swap(entryPoint->owner, tail.entryPoint->owner);
+	}
+
+	auto before = first->prev.lock();
+	auto last = entryPoint->prev.lock();
+	link(before, entryPoint);
+
+	tail.link(tail.entryPoint, first);
+	tail.link(last, tail.entryPoint);
+	tail.m_size = count;
+	m_size -= count;
+
+	if (m_hasher) {
+		rehash();
+		tail.rehash();
+	}
+
+	return tail;
+}
+
+template<class T>
+template<class UnaryPredicate>
+typename safelist<T>::iterator safelist<T>::partition(UnaryPredicate pred)
+{
+	if (empty()) {
+		return end();
+	}
+
+	normalize();
+
+	// Hoare partition: lo is the i-th entry and hi the one before the j-th,
+	// everything before lo matches and everything from hi on does not.
+	entry* lo = entryPoint->next.get();
+	auto hi = entryPoint->prev.lock();
+	size_type i = 0, j = m_size;
+	for (;;) {
+		for (; i < j && pred(*lo->value); ++i) {
+			lo = lo->next.get();
+		}
+		for (; i < j && !pred(*hi->value); --j) {
+			hi = hi->prev.lock();
+		}
+		if (i == j) {
+			break;
+		}
+
+		std::swap(lo->value, hi->value);
+		lo = lo->next.get();
+		++i;
+		hi = hi->prev.lock();
+		--j;
+	}
+
+	if (m_hasher) {
+		rehash();
+	}
+
+	// lo has no owner of its own to hand out, but its successor's prev
+	// link refers to it.
+	return lo == entryPoint.get() ? end() : iterator(lo->next->prev);
+}
+
+template<class T>
+template<class UnaryPredicate>
+typename safelist<T>::iterator safelist<T>::stable_partition(UnaryPredicate pred)
+{
+	if (empty()) {
+		return end();
+	}
+
+	normalize();
+
+	// Matching entries are appended straight to the sentinel, the others
+	// to a chain of their own. Each chain is named by the link that owns
+	// its last entry, so prev links can be set on the way.
+	auto node = detach_chain();
+	std::shared_ptr<entry> rest;
+	std::shared_ptr<entry>* matchLast = &entryPoint;
+	std::shared_ptr<entry>* restLast = nullptr;
+
+	try {
+		while (node) {
+			const bool match = pred(*node->value);
+			auto next = std::move(node->next);
+			if (match) {
+				node->prev = *matchLast;
+				(*matchLast)->next = std::move(node);
+				matchLast = &(*matchLast)->next;
+			} else if (restLast) {
+				node->prev = *restLast;
+				(*restLast)->next = std::move(node);
+				restLast = &(*restLast)->next;
+			} else {
+				rest = std::move(node);
+				restLast = &rest;
+			}
+			node = std::move(next);
+		}
+	} catch (...) {
+		// Keep everything, the unvisited entries last.
+		if (restLast) {
+			(*restLast)->next = std::move(node);
+			node = std::move(rest);
+		}
+		(*matchLast)->next = std::move(node);
+		attach_chain(std::move(entryPoint->next));
+		throw;
+	}
+
+	iterator result = end();
+	if (restLast) {
+		result = iterator(rest);
+		rest->prev = *matchLast;
+		(*matchLast)->next = std::move(rest);
+		matchLast = restLast == &rest ? &(*matchLast)->next : restLast;
+	}
+	entryPoint->prev = *matchLast;
+	(*matchLast)->next = entryPoint;
+
+	if (m_hasher) {
+		rehash();
+	}
+
+	return result;
+}
+
+
+// Reclaimer functions
+template<class T>
+safelist<T>::reclaimer::~reclaimer()
+{
+	for (auto& chain : chains) {
+		release_chain(std::move(chain));
+	}
+}
+
+// Like release_chain(), stops at entries still referenced elsewhere, as
+// those belong to a list or are freed along with whatever holds them.
+template<class T>
+typename safelist<T>::size_type safelist<T>::reclaimer::reclaim(size_type budget)
+{
+	size_type freed = 0;
+	while (freed < budget && !chains.empty()) {
+		auto& chain = chains.back();
+		if (chain && chain.use_count() == 1) {
+			auto next = std::move(chain->next);
+			chain = std::move(next);
+			++freed;
+		} else {
+			chains.pop_back();
+		}
+	}
+
+	return freed;
+}
+
+// Node handle functions
+template<class T>
+T& safelist<T>::node_type::value() const
+{
+	if (!item) {
+		throw std::logic_error("Empty node handle");
+	}
+
+	return *item->value;
+}
 
 // Iterator functions
 template<class T>
-safelist<T>::iterator::iterator(const_iterator it) : item(std::const_pointer_cast<entry>(it.item.lock()))
+safelist<T>::iterator::iterator(const_iterator it) :
+	item(std::const_pointer_cast<entry>(it.item.lock()))
 {
 }
 
 template<class T>
 typename safelist<T>::iterator& safelist<T>::iterator::operator++()
 {
-	item = item.lock()->next;
+	auto e = item.lock();
+	if (e->owner && *e->owner) {
+		item = e->prev;
+	} else {
+		item = e->next;
+	}
 	return *this;
 }
 
@@ -876,7 +2650,12 @@ typename safelist<T>::iterator safelist<T>::iterator::operator++(int)
 template<class T>
 typename safelist<T>::iterator& safelist<T>::iterator::operator--()
 {
-	item = item.lock()->prev;
+	auto e = item.lock();
+	if (e->owner && *e->owner) {
+		item = e->next;
+	} else {
+		item = e->prev;
+	}
 
 	return *this;
 }
@@ -896,6 +2675,12 @@ T& safelist<T>::iterator::operator*() const
 	return *item.lock()->value;
 }
 
+template<class T>
+T* safelist<T>::iterator::operator->() const
+{
+	return item.lock()->value.get();
+}
+
 template<class T>
 bool safelist<T>::iterator::operator==(const iterator& other) const
 {
@@ -910,14 +2695,20 @@ bool safelist<T>::iterator::operator!=(const iterator& other) const
 
 // Const iterator functions. Mostly repeated from above
 template<class T>
-safelist<T>::const_iterator::const_iterator(const safelist<T>::iterator& it): item(it.item)
+safelist<T>::const_iterator::const_iterator(const safelist<T>::iterator& it):
+	item(it.item)
 {
 }
 
 template<class T>
 typename safelist<T>::const_iterator& safelist<T>::const_iterator::operator++()
 {
-	item = item.lock()->next;
+	auto e = item.lock();
+	if (e->owner && *e->owner) {
+		item = e->prev;
+	} else {
+		item = e->next;
+	}
 	return *this;
 }
 
@@ -933,7 +2724,12 @@ typename safelist<T>::const_iterator safelist<T>::const_iterator::operator++(int
 template<class T>
 typename safelist<T>::const_iterator& safelist<T>::const_iterator::operator--()
 {
-	item = item.lock()->prev;
+	auto e = item.lock();
+	if (e->owner && *e->owner) {
+		item = e->next;
+	} else {
+		item = e->prev;
+	}
 
 	return *this;
 }
@@ -953,6 +2749,12 @@ const T& safelist<T>::const_iterator::operator*() const
 	return *item.lock()->value;
 }
 
+template<class T>
+const T* safelist<T>::const_iterator::operator->() const
+{
+	return item.lock()->value.get();
+}
+
 template<class T>
 bool safelist<T>::const_iterator::operator==(const const_iterator& other) const
 {
@@ -0,0 +1,460 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L
+#include <ranges>
+#endif
+
+// Lazy views over safelist, or any other range with at least forward
+// iterators. Views are composed with |, and nothing is copied or allocated
+// until the result is iterated:
+//
+//     using namespace safelist_views;
+//     for (auto& x : l | filter(is_even) | transform(square) | take(3)) ...
+//
+// A view refers to the list it was made from, so the list has to outlive
+// it. Views built from other views hold them by value. Iterators refer to
+// their view, like those of std::ranges views.
+//
+// filter, transform and drop keep the iterator category of what they view,
+// so over a safelist they are bidirectional. take is forward only, as its
+// end() cannot be found without walking the list. Under C++20 the views
+// model std::ranges::view.
+namespace safelist_views
+{
+	struct view_base
+#if __cplusplus >= 202002L
+		: std::ranges::view_base
+#endif
+	{
+	};
+
+	template<class R>
+	using is_view = std::is_base_of<view_base, typename std::decay<R>::type>;
+
+	template<class R>
+	using iterator_t = decltype(std::declval<R&>().begin());
+
+	template<class Iterator>
+	using category_t = typename std::iterator_traits<Iterator>::iterator_category;
+
+	template<class>
+	struct void_type
+	{
+		typedef void type;
+	};
+
+	// The C++20 iterator_concept where there is one, which can be stronger
+	// than the category.
+	template<class Iterator, class = void>
+	struct concept_of
+	{
+		typedef category_t<Iterator> type;
+	};
+
+	template<class Iterator>
+	struct concept_of<Iterator, typename void_type<typename Iterator::iterator_concept>::type>
+	{
+		typedef typename Iterator::iterator_concept type;
+	};
+
+	template<class Iterator>
+	using concept_t = typename concept_of<Iterator>::type;
+
+	// Tag, or limit if that is weaker.
+	template<class Tag, class Limit>
+	using at_most = typename std::conditional<std::is_base_of<Limit, Tag>::value, Limit, Tag>::type;
+
+	// Non-owning view of a whole container.
+	template<class R>
+	class ref_view : public view_base
+	{
+		public:
+			ref_view() noexcept: r(nullptr) {};
+			explicit ref_view(R& r) noexcept: r(&r) {};
+
+			iterator_t<R> begin() const { return r->begin(); };
+			iterator_t<R> end() const { return r->end(); };
+
+		private:
+			R* r;
+	};
+
+	// Views are taken as they are, containers by reference.
+	template<class R>
+	using all_t = typename std::conditional<is_view<R>::value,
+		typename std::decay<R>::type,
+		ref_view<typename std::remove_reference<R>::type>>::type;
+
+	template<class R>
+	all_t<R> all(R&& r)
+	{
+		static_assert(is_view<R>::value || std::is_lvalue_reference<R>::value,
+			"Views of temporary containers would dangle");
+
+		return all_t<R>(std::forward<R>(r));
+	}
+
+	// Holds a function object and makes it assignable, which lambdas are
+	// not, so that the views holding one are.
+	template<class F>
+	class box
+	{
+		public:
+			box() noexcept: engaged(false) {};
+			explicit box(const F& f): engaged(true) { new (storage) F(f); };
+			box(const box& other): engaged(other.engaged)
+			{
+				if (engaged) {
+					new (storage) F(other.get());
+				}
+			};
+			box& operator=(const box& other)
+			{
+				if (this != &other) {
+					reset();
+					if (other.engaged) {
+						new (storage) F(other.get());
+						engaged = true;
+					}
+				}
+
+				return *this;
+			};
+			~box() { reset(); };
+
+			template<class... Args>
+			auto operator()(Args&&... args) const -> decltype(std::declval<const F&>()(std::forward<Args>(args)...))
+			{
+				return get()(std::forward<Args>(args)...);
+			}
+
+		private:
+			alignas(F) unsigned char storage[sizeof(F)];
+			bool engaged;
+
+			const F& get() const { return *reinterpret_cast<const F*>(storage); };
+
+			void reset()
+			{
+				if (engaged) {
+					reinterpret_cast<F*>(storage)->~F();
+					engaged = false;
+				}
+			}
+	};
+
+	// Remembers a position for a view. Copies start out empty, as the
+	// position may refer to the view it was found in.
+	template<class Iterator>
+	class position_cache
+	{
+		public:
+			position_cache(): engaged(false) {};
+			position_cache(const position_cache&): engaged(false) {};
+			position_cache& operator=(const position_cache&) { engaged = false; return *this; };
+
+			bool has_value() const { return engaged; };
+			const Iterator& get() const { return it; };
+			void set(Iterator pos) { it = std::move(pos); engaged = true; };
+
+		private:
+			Iterator it;
+			bool engaged;
+	};
+
+	// Elements for which pred holds.
+	template<class V, class Pred>
+	class filter_view : public view_base
+	{
+		public:
+			class iterator;
+
+			filter_view() = default;
+			filter_view(V base, const Pred& pred): base(std::move(base)), pred(pred) {};
+
+			// Finds the first match on the first call only, like
+			// std::ranges::filter_view, so that begin() and empty() take
+			// constant time after that. Elements should not be inserted
+			// before the first match, nor should it be erased, while the
+			// view is in use.
+			iterator begin() const;
+			iterator end() const;
+
+		private:
+			V base;
+			box<Pred> pred;
+			mutable position_cache<iterator_t<const V>> first;
+	};
+
+	template<class V, class Pred>
+	class filter_view<V, Pred>::iterator
+	{
+		public:
+			typedef iterator_t<const V> base_iterator;
+			typedef typename std::iterator_traits<base_iterator>::difference_type difference_type;
+			typedef typename std::iterator_traits<base_iterator>::value_type value_type;
+			typedef typename std::iterator_traits<base_iterator>::pointer pointer;
+			typedef typename std::iterator_traits<base_iterator>::reference reference;
+			typedef at_most<category_t<base_iterator>, std::bidirectional_iterator_tag> iterator_category;
+			typedef at_most<concept_t<base_iterator>, std::bidirectional_iterator_tag> iterator_concept;
+
+			iterator(): parent(nullptr) {};
+
+			reference operator*() const { return *current; };
+			pointer operator->() const { return &*current; };
+
+			iterator& operator++()
+			{
+				for (++current; current != last && !parent->pred(*current); ++current);
+				return *this;
+			};
+			iterator operator++(int) { auto copy = *this; ++*this; return copy; };
+
+			iterator& operator--()
+			{
+				for (--current; !parent->pred(*current); --current);
+				return *this;
+			};
+			iterator operator--(int) { auto copy = *this; --*this; return copy; };
+
+			bool operator==(const iterator& other) const { return current == other.current; };
+			bool operator!=(const iterator& other) const { return current != other.current; };
+
+		private:
+			friend filter_view;
+
+			base_iterator current;
+			base_iterator last;
+			const filter_view* parent;
+
+			iterator(base_iterator current, base_iterator last, const filter_view* parent):
+				current(std::move(current)), last(std::move(last)), parent(parent) {};
+	};
+
+	template<class V, class Pred>
+	typename filter_view<V, Pred>::iterator filter_view<V, Pred>::begin() const
+	{
+		const auto last = base.end();
+		if (!first.has_value()) {
+			auto it = base.begin();
+			for (; it != last && !pred(*it); ++it);
+			first.set(std::move(it));
+		}
+
+		return iterator(first.get(), last, this);
+	}
+
+	template<class V, class Pred>
+	typename filter_view<V, Pred>::iterator filter_view<V, Pred>::end() const
+	{
+		const auto last = base.end();
+		return iterator(last, last, this);
+	}
+
+	// The result of f on every element.
+	template<class V, class F>
+	class transform_view : public view_base
+	{
+		public:
+			class iterator;
+
+			transform_view() = default;
+			transform_view(V base, const F& f): base(std::move(base)), f(f) {};
+
+			iterator begin() const { return iterator(base.begin(), this); };
+			iterator end() const { return iterator(base.end(), this); };
+
+		private:
+			V base;
+			box<F> f;
+	};
+
+	template<class V, class F>
+	class transform_view<V, F>::iterator
+	{
+		public:
+			typedef iterator_t<const V> base_iterator;
+			typedef typename std::iterator_traits<base_iterator>::difference_type difference_type;
+			typedef decltype(std::declval<const box<F>&>()(*std::declval<base_iterator>())) reference;
+			typedef typename std::decay<reference>::type value_type;
+			typedef void pointer;
+			// Results that are not references can only be read once, as
+			// far as the classic categories are concerned.
+			typedef typename std::conditional<std::is_lvalue_reference<reference>::value,
+				category_t<base_iterator>, std::input_iterator_tag>::type iterator_category;
+			typedef concept_t<base_iterator> iterator_concept;
+
+			iterator(): parent(nullptr) {};
+
+			reference operator*() const { return parent->f(*current); };
+
+			iterator& operator++() { ++current; return *this; };
+			iterator operator++(int) { auto copy = *this; ++current; return copy; };
+			iterator& operator--() { --current; return *this; };
+			iterator operator--(int) { auto copy = *this; --current; return copy; };
+
+			bool operator==(const iterator& other) const { return current == other.current; };
+			bool operator!=(const iterator& other) const { return current != other.current; };
+
+		private:
+			friend transform_view;
+
+			base_iterator current;
+			const transform_view* parent;
+
+			iterator(base_iterator current, const transform_view* parent): current(std::move(current)), parent(parent) {};
+	};
+
+	// The first count elements, or all of them if there are fewer.
+	template<class V>
+	class take_view : public view_base
+	{
+		public:
+			class iterator;
+
+			take_view(): count(0) {};
+			take_view(V base, std::size_t count): base(std::move(base)), count(count) {};
+
+			iterator begin() const { return iterator(base.begin(), count); };
+			iterator end() const { return iterator(base.end(), 0); };
+
+		private:
+			V base;
+			std::size_t count;
+	};
+
+	template<class V>
+	class take_view<V>::iterator
+	{
+		public:
+			typedef iterator_t<const V> base_iterator;
+			typedef typename std::iterator_traits<base_iterator>::difference_type difference_type;
+			typedef typename std::iterator_traits<base_iterator>::value_type value_type;
+			typedef typename std::iterator_traits<base_iterator>::pointer pointer;
+			typedef typename std::iterator_traits<base_iterator>::reference reference;
+			typedef at_most<category_t<base_iterator>, std::forward_iterator_tag> iterator_category;
+			typedef at_most<concept_t<base_iterator>, std::forward_iterator_tag> iterator_concept;
+
+			iterator(): remaining(0) {};
+
+			reference operator*() const { return *current; };
+			pointer operator->() const { return &*current; };
+
+			iterator& operator++() { ++current; --remaining; return *this; };
+			iterator operator++(int) { auto copy = *this; ++*this; return copy; };
+
+			// Positions in one view are told apart by how many elements
+			// are left, except past the end of a shorter list.
+			bool operator==(const iterator& other) const { return remaining == other.remaining || current == other.current; };
+			bool operator!=(const iterator& other) const { return !(*this == other); };
+
+		private:
+			friend take_view;
+
+			base_iterator current;
+			std::size_t remaining;
+
+			iterator(base_iterator current, std::size_t remaining): current(std::move(current)), remaining(remaining) {};
+	};
+
+	// Everything but the first count elements.
+	template<class V>
+	class drop_view : public view_base
+	{
+		public:
+			typedef iterator_t<const V> iterator;
+
+			drop_view(): count(0) {};
+			drop_view(V base, std::size_t count): base(std::move(base)), count(count) {};
+
+			// Skips the dropped elements on every call.
+			iterator begin() const
+			{
+				auto first = base.begin();
+				const auto last = base.end();
+				for (std::size_t i = 0; i < count && first != last; ++i, ++first);
+
+				return first;
+			}
+			iterator end() const { return base.end(); };
+
+		private:
+			V base;
+			std::size_t count;
+	};
+
+	// Adaptors, for use with |.
+	template<class Pred>
+	struct filter_adaptor
+	{
+		Pred pred;
+	};
+
+	template<class F>
+	struct transform_adaptor
+	{
+		F f;
+	};
+
+	struct take_adaptor
+	{
+		std::size_t count;
+	};
+
+	struct drop_adaptor
+	{
+		std::size_t count;
+	};
+
+	template<class Pred>
+	filter_adaptor<Pred> filter(Pred pred)
+	{
+		return {std::move(pred)};
+	}
+
+	template<class F>
+	transform_adaptor<F> transform(F f)
+	{
+		return {std::move(f)};
+	}
+
+	inline take_adaptor take(std::size_t count)
+	{
+		return {count};
+	}
+
+	inline drop_adaptor drop(std::size_t count)
+	{
+		return {count};
+	}
+
+	template<class R, class Pred>
+	filter_view<all_t<R>, Pred> operator|(R&& r, const filter_adaptor<Pred>& a)
+	{
+		return filter_view<all_t<R>, Pred>(all(std::forward<R>(r)), a.pred);
+	}
+
+	template<class R, class F>
+	transform_view<all_t<R>, F> operator|(R&& r, const transform_adaptor<F>& a)
+	{
+		return transform_view<all_t<R>, F>(all(std::forward<R>(r)), a.f);
+	}
+
+	template<class R>
+	take_view<all_t<R>> operator|(R&& r, take_adaptor a)
+	{
+		return take_view<all_t<R>>(all(std::forward<R>(r)), a.count);
+	}
+
+	template<class R>
+	drop_view<all_t<R>> operator|(R&& r, drop_adaptor a)
+	{
+		return drop_view<all_t<R>>(all(std::forward<R>(r)), a.count);
+	}
+}
@@ -0,0 +1,84 @@
+#include "sharded_safelist.hpp"
+#include "safelist.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Threads append a fixed number of elements each to one shared list, the
+// way log collectors do; reports appends per second, including collecting
+// them at the end, for a growing number of threads.
+
+// Runs the appending threads and returns appends/s.
+template<class Setup, class Append, class Collect>
+double run(unsigned threads, size_t count, Setup setup, Append append, Collect collect)
+{
+	const auto start = chrono::steady_clock::now();
+
+	vector<thread> workers;
+	for (unsigned i = 0; i < threads; ++i) {
+		workers.emplace_back([&] {
+			auto state = setup();
+			for (size_t j = 0; j < count; ++j) {
+				append(state, j);
+			}
+		});
+	}
+
+	for (auto& t : workers) {
+		t.join();
+	}
+
+	if (collect() != threads * count) {
+		cerr << "Lost elements" << endl;
+		exit(1);
+	}
+
+	const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return threads * count / elapsed.count();
+}
+
+double bench_sharded(unsigned threads, size_t count)
+{
+	sharded_safelist<uint64_t> l;
+	safelist<uint64_t> collected;
+	return run(threads, count,
+		[&] { return l.make_appender(); },
+		[](sharded_safelist<uint64_t>::appender& a, uint64_t v) { a.push_back(v); },
+		[&] {
+			collected = l.collect();
+			return collected.size();
+		});
+}
+
+double bench_locked(unsigned threads, size_t count)
+{
+	safelist<uint64_t> l;
+	mutex m;
+	return run(threads, count,
+		[] { return 0; },
+		[&](int, uint64_t v) {
+			lock_guard<mutex> lock(m);
+			l.push_back(v);
+		},
+		[&] { return l.size(); });
+}
+
+int main(int argc, char** argv)
+{
+	const unsigned max_threads = argc > 1 ? atoi(argv[1]) : 64;
+	const size_t count = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100000;
+
+	cout << "threads\tsharded_safelist appends/s\tlocked safelist appends/s" << endl;
+	for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+		const auto locked = bench_locked(threads, count);
+		cout << threads << '\t' << bench_sharded(threads, count) << '\t' << locked << endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "safelist.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Append-mostly list for many writing threads.
+//
+// Each writing thread appends to a segment of its own, through an appender
+// obtained from make_appender(). Appending takes no lock and touches no
+// memory shared with other writers. The elements are read by collecting
+// them: collect() takes everything appended so far out of the segments as
+// a single safelist, by splicing the segments together.
+//
+// A segment has two lists. Its appender pushes onto the active one, and a
+// collector makes the other one active before taking the first. The
+// appender flags itself busy around each push, and the collector waits for
+// a push in progress to finish, so an appender never waits on anything.
+//
+// Appenders must be destroyed before the list is.
+template<class T>
+class sharded_safelist
+{
+	public:
+		typedef T value_type;
+		typedef std::size_t size_type;
+
+		class appender;
+
+		sharded_safelist() = default;
+		sharded_safelist(const sharded_safelist&) = delete;
+		sharded_safelist& operator=(const sharded_safelist&) = delete;
+
+		appender make_appender();
+
+		// Takes all elements appended so far, in O(segments). Elements
+		// from one appender keep their order, but the segments are simply
+		// joined one after another.
+		safelist<value_type> collect();
+
+		// The same, but merges the segments by comp instead, which orders
+		// everything if each appender pushes in increasing order, for
+		// instance by a timestamp or sequence number in the elements.
+		template<class Compare>
+		safelist<value_type> collect(Compare comp);
+
+		// Number of segments, which is the most appenders there ever were
+		// at the same time.
+		size_type segments() const;
+
+	private:
+		// Padded so that appenders do not share cache lines.
+		struct segment
+		{
+			char padding[64];
+			std::atomic<bool> busy;
+			std::atomic<unsigned> active;
+			safelist<value_type> lists[2];
+			bool used;
+
+			segment(): busy(false), active(0), used(true) {};
+		};
+
+		mutable std::mutex collector;
+		std::vector<std::unique_ptr<segment>> m_segments;
+
+		// Expects the collector mutex to be held.
+		static safelist<value_type> take(segment& s);
+};
+
+// A writing thread's handle on the list. Not thread safe itself.
+template<class T>
+class sharded_safelist<T>::appender
+{
+	public:
+		friend sharded_safelist<T>;
+
+		appender(appender&& other);
+		appender(const appender&) = delete;
+		appender& operator=(const appender&) = delete;
+
+		// The segment can be reused by a new appender. Its elements stay
+		// until they are collected.
+		~appender();
+
+		void push_back(const value_type& value) { emplace_back(value); };
+		void push_back(value_type&& value) { emplace_back(std::move(value)); };
+
+		template<class... Args>
+		void emplace_back(Args&&... args);
+
+	private:
+		sharded_safelist* list;
+		segment* own;
+
+		appender(sharded_safelist* list, segment* own): list(list), own(own) {};
+};
+
+template<class T>
+typename sharded_safelist<T>::appender sharded_safelist<T>::make_appender()
+{
+	std::lock_guard<std::mutex> lock(collector);
+
+	for (auto& s : m_segments) {
+		if (!s->used) {
+			s->used = true;
+			return appender(this, s.get());
+		}
+	}
+
+	m_segments.emplace_back(new segment());
+	return appender(this, m_segments.back().get());
+}
+
+template<class T>
+safelist<T> sharded_safelist<T>::collect()
+{
+	std::lock_guard<std::mutex> lock(collector);
+
+	safelist<value_type> result;
+	for (auto& s : m_segments) {
+		auto taken = take(*s);
+		result.splice(result.end(), taken);
+	}
+
+	return result;
+}
+
+template<class T>
+template<class Compare>
+safelist<T> sharded_safelist<T>::collect(Compare comp)
+{
+	std::vector<safelist<value_type>> taken;
+	{
+		std::lock_guard<std::mutex> lock(collector);
+		taken.reserve(m_segments.size());
+		for (auto& s : m_segments) {
+			taken.push_back(take(*s));
+		}
+	}
+
+	safelist<value_type> result;
+	result.merge_all(taken, comp);
+
+	return result;
+}
+
+template<class T>
+typename sharded_safelist<T>::size_type sharded_safelist<T>::segments() const
+{
+	std::lock_guard<std::mutex> lock(collector);
+
+	return m_segments.size();
+}
+
+// Both the switch and the check of busy are sequentially consistent, like
+// their counterparts in emplace_back(): either the appender sees the new
+// active list, or this sees it busy and waits for it.
+template<class T>
+safelist<T> sharded_safelist<T>::take(segment& s)
+{
+	const auto old = s.active.load(std::memory_order_relaxed);
+	s.active.store(old ^ 1);
+	while (s.busy.load()) {
+		std::this_thread::yield();
+	}
+
+	return std::move(s.lists[old]);
+}
+
+template<class T>
+sharded_safelist<T>::appender::appender(appender&& other): list(other.list), own(other.own)
+{
+	other.list = nullptr;
+	other.own = nullptr;
+}
+
+template<class T>
+sharded_safelist<T>::appender::~appender()
+{
+	if (own) {
+		std::lock_guard<std::mutex> lock(list->collector);
+		own->used = false;
+	}
+}
+
+template<class T>
+template<class... Args>
+void sharded_safelist<T>::appender::emplace_back(Args&&... args)
+{
+	own->busy.store(true);
+	const auto active = own->active.load();
+
+	try {
+		own->lists[active].emplace_back(std::forward<Args>(args)...);
+	} catch (...) {
+		own->busy.store(false, std::memory_order_release);
+		throw;
+	}
+
+	own->busy.store(false, std::memory_order_release);
+}
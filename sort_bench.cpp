@@ -0,0 +1,46 @@
+#include "safelist.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Times the sorts available for a list of random uint64_t values.
+template<class List, class Sort>
+void bench(const char* name, const vector<uint64_t>& values, Sort sort)
+{
+	List l(values.begin(), values.end());
+
+	auto start = chrono::steady_clock::now();
+	sort(l);
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+	cout << name << ": " << elapsed.count() << " s" << endl;
+}
+
+int main(int argc, char** argv)
+{
+	const size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+	mt19937_64 r((random_device())());
+	vector<uint64_t> values(count);
+	for (auto& v : values) {
+		v = r();
+	}
+
+	bench<safelist<uint64_t>>("safelist::sort", values, [](safelist<uint64_t>& l) {
+		l.sort();
+	});
+	bench<safelist<uint64_t>>("safelist::sort_by_key", values, [](safelist<uint64_t>& l) {
+		l.sort_by_key([](uint64_t v) { return v; });
+	});
+	bench<list<uint64_t>>("std::list::sort", values, [](list<uint64_t>& l) {
+		l.sort();
+	});
+
+	return 0;
+}
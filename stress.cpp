@@ -1,38 +1,340 @@
+// Workload driver: replays a trace of list operations, or generates a random
+// mix of them, against safelist or std::list and reports throughput,
+// per-operation latency percentiles and peak memory use.
+//
+// Trace files are plain text with one operation per line:
+//
+//     <operation> [a [b]]
+//
+// where <operation> is one of the names in op_names. Arguments are values
+// for the push operations and positions otherwise. Positions are reduced
+// modulo the list size at replay time, so any trace is valid for any list.
+// Lines starting with '#' are ignored.
 #include "safelist.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
 #include <list>
 #include <random>
-#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
 
 using namespace std;
 
-template<class T>
-void stress(int count)
+enum op_kind {
+	PUSH_BACK,
+	PUSH_FRONT,
+	POP_BACK,
+	POP_FRONT,
+	INSERT,
+	ERASE,
+	SPLICE,
+	ITERATE,
+	SORT,
+	REVERSE,
+	OP_KINDS
+};
+
+const char* const op_names[OP_KINDS] = {
+	"push_back",
+	"push_front",
+	"pop_back",
+	"pop_front",
+	"insert",
+	"erase",
+	"splice",
+	"iterate",
+	"sort",
+	"reverse",
+};
+
+const double default_mix[OP_KINDS] = {30, 10, 10, 10, 10, 10, 5, 4, 1, 1};
+
+// Keeps the iterate operation from being optimised away.
+volatile uint64_t sink;
+
+struct op
+{
+	op_kind kind;
+	uint64_t a;
+	uint64_t b;
+};
+
+static bool parse_kind(const string& name, op_kind& kind)
+{
+	for (int i = 0; i < OP_KINDS; ++i) {
+		if (name == op_names[i]) {
+			kind = static_cast<op_kind>(i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static vector<op> read_trace(istream& in)
 {
-	T t;
+	vector<op> trace;
+	string line;
+	for (size_t lineno = 1; getline(in, line); ++lineno) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
 
-	// Initialize with random data
-	mt19937_64 r((random_device())());
+		istringstream fields(line);
+		string name;
+		op o = {PUSH_BACK, 0, 0};
+		fields >> name >> o.a >> o.b;
+		if (!parse_kind(name, o.kind)) {
+			throw runtime_error("Unknown operation on line " + to_string(lineno) + ": " + name);
+		}
 
-	for (;count > 0; --count) {
-		t.push_back(r());
+		trace.push_back(o);
 	}
 
-	t.sort();
+	return trace;
 }
 
-int main(int argc, char** argv)
+static void write_trace(ostream& out, const vector<op>& trace)
+{
+	for (auto& o : trace) {
+		out << op_names[o.kind] << ' ' << o.a << ' ' << o.b << '\n';
+	}
+}
+
+// Parses "name=weight,name=weight,..." on top of an all-zero mix.
+static void parse_mix(const string& spec, double mix[OP_KINDS])
 {
+	fill(mix, mix + OP_KINDS, 0);
 
-	assert(argc >= 2);
-	if (argc == 2) {
-		for (int i = 100; i > 0; --i) {
-			stress<safelist<uint64_t>>(atoi(argv[1]));
+	istringstream items(spec);
+	string item;
+	while (getline(items, item, ',')) {
+		auto eq = item.find('=');
+		op_kind kind;
+		if (eq == string::npos || !parse_kind(item.substr(0, eq), kind)) {
+			throw runtime_error("Invalid mix entry: " + item);
 		}
+
+		mix[kind] = stod(item.substr(eq + 1));
+	}
+}
+
+static vector<op> generate_trace(size_t count, const double mix[OP_KINDS], uint64_t seed)
+{
+	mt19937_64 r(seed);
+	discrete_distribution<int> pick(mix, mix + OP_KINDS);
+
+	vector<op> trace;
+	trace.reserve(count);
+	while (count--) {
+		trace.push_back({static_cast<op_kind>(pick(r)), r(), r()});
+	}
+
+	return trace;
+}
+
+// Iterator to a position in [0, size], walking from the nearest end.
+template<class List>
+typename List::iterator position(List& l, uint64_t index)
+{
+	const auto size = l.size();
+	index %= size + 1;
+
+	if (index <= size / 2) {
+		auto it = l.begin();
+		advance(it, index);
+		return it;
 	} else {
-		for (int i = 100; i > 0; --i) {
-			stress<list<uint64_t>>(atoi(argv[2]));
+		auto it = l.end();
+		advance(it, -static_cast<typename List::difference_type>(size - index));
+		return it;
+	}
+}
+
+template<class List>
+void apply(List& l, const op& o)
+{
+	switch (o.kind) {
+		case PUSH_BACK:
+			l.push_back(o.a);
+			break;
+
+		case PUSH_FRONT:
+			l.push_front(o.a);
+			break;
+
+		case POP_BACK:
+			if (!l.empty()) {
+				l.pop_back();
+			}
+			break;
+
+		case POP_FRONT:
+			if (!l.empty()) {
+				l.pop_front();
+			}
+			break;
+
+		case INSERT:
+			l.insert(position(l, o.a), o.b);
+			break;
+
+		case ERASE:
+			if (!l.empty()) {
+				l.erase(position(l, o.a % l.size()));
+			}
+			break;
+
+		case SPLICE:
+			if (!l.empty()) {
+				l.splice(position(l, o.b), l, position(l, o.a % l.size()));
+			}
+			break;
+
+		case ITERATE:
+			{
+				uint64_t sum = 0;
+				for (auto v : l) {
+					sum += v;
+				}
+				sink = sum;
+			}
+			break;
+
+		case SORT:
+			l.sort();
+			break;
+
+		case REVERSE:
+			l.reverse();
+			break;
+
+		default:
+			break;
+	}
+}
+
+static uint64_t percentile(const vector<uint64_t>& sorted, double p)
+{
+	if (sorted.empty()) {
+		return 0;
+	}
+
+	return sorted[min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+template<class List>
+void replay(const vector<op>& trace)
+{
+	typedef chrono::steady_clock clock;
+
+	List l;
+	vector<uint64_t> latencies[OP_KINDS];
+
+	const auto start = clock::now();
+	for (auto& o : trace) {
+		const auto before = clock::now();
+		apply(l, o);
+		const auto after = clock::now();
+		latencies[o.kind].push_back(chrono::duration_cast<chrono::nanoseconds>(after - before).count());
+	}
+	const chrono::duration<double> elapsed = clock::now() - start;
+
+	cout << trace.size() << " operations in " << elapsed.count() << " s, "
+		<< trace.size() / elapsed.count() << " ops/s, final size " << l.size() << endl;
+
+	cout << "operation\tcount\tp50 ns\tp99 ns\tp999 ns" << endl;
+	for (int i = 0; i < OP_KINDS; ++i) {
+		auto& lat = latencies[i];
+		if (lat.empty()) {
+			continue;
+		}
+
+		sort(lat.begin(), lat.end());
+		cout << op_names[i] << '\t' << lat.size()
+			<< '\t' << percentile(lat, 0.5)
+			<< '\t' << percentile(lat, 0.99)
+			<< '\t' << percentile(lat, 0.999) << endl;
+	}
+
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	cout << "peak RSS: " << usage.ru_maxrss << " KiB" << endl;
+}
+
+static void usage(const char* name)
+{
+	cerr << "Usage: " << name << " [-h] [-l] [-t TRACE | -n COUNT [-m MIX] [-s SEED] [-w OUT]]" << endl
+		<< "  -h        show this help" << endl
+		<< "  -l        use std::list instead of safelist" << endl
+		<< "  -t TRACE  replay operations from a trace file" << endl
+		<< "  -n COUNT  generate COUNT random operations (default 20000)" << endl
+		<< "  -m MIX    operation weights, e.g. push_back=3,sort=1" << endl
+		<< "  -s SEED   random seed for generated operations" << endl
+		<< "  -w OUT    write the generated trace to OUT and exit" << endl;
+}
+
+int main(int argc, char** argv)
+{
+	bool use_std = false;
+	string trace_file, out_file;
+	size_t count = 20000;
+	uint64_t seed = random_device()();
+	double mix[OP_KINDS];
+	copy(default_mix, default_mix + OP_KINDS, mix);
+
+	try {
+		int c;
+		while ((c = getopt(argc, argv, "hlt:n:m:s:w:")) != -1) {
+			switch (c) {
+				case 'h':
+					usage(argv[0]);
+					return 0;
+				case 'l': use_std = true; break;
+				case 't': trace_file = optarg; break;
+				case 'n': count = strtoull(optarg, nullptr, 10); break;
+				case 'm': parse_mix(optarg, mix); break;
+				case 's': seed = strtoull(optarg, nullptr, 10); break;
+				case 'w': out_file = optarg; break;
+				default:
+					usage(argv[0]);
+					return 1;
+			}
+		}
+
+		vector<op> trace;
+		if (!trace_file.empty()) {
+			ifstream in(trace_file);
+			if (!in) {
+				throw runtime_error("Cannot open " + trace_file);
+			}
+			trace = read_trace(in);
+		} else {
+			trace = generate_trace(count, mix, seed);
+		}
+
+		if (!out_file.empty()) {
+			ofstream out(out_file);
+			write_trace(out, trace);
+			return 0;
+		}
+
+		if (use_std) {
+			replay<list<uint64_t>>(trace);
+		} else {
+			replay<safelist<uint64_t>>(trace);
 		}
+	} catch (const exception& e) {
+		cerr << e.what() << endl;
+		return 1;
 	}
 
 	return 0;
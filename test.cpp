@@ -1,9 +1,76 @@
 #include "safelist.hpp"
+#include "safe_lru_cache.hpp"
+#include "rcu_safelist.hpp"
+#include "intrusive_safelist.hpp"
+#include "safe_forward_list.hpp"
+#include "safelist_views.hpp"
+#include "packed_safelist.hpp"
+#include "sharded_safelist.hpp"
+#include "weak_observer_list.hpp"
+#include "timing_wheel.hpp"
+#if __cplusplus >= 202002L
+#include "safe_channel.hpp"
+#endif
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <forward_list>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <new>
+#include <string>
 #include <iterator>
 #include <list>
 #include <typeinfo>
+#include <vector>
+
+// Every heap allocation in the program is counted, so that the -a mode can
+// check how many allocations each operation performs, and how much memory
+// stays in use. Each block starts with a header recording its size.
+static std::size_t allocations = 0;
+static std::size_t live_bytes = 0;
+static const std::size_t header = alignof(std::max_align_t);
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	++allocations;
+	auto block = static_cast<char*>(std::malloc(header + size));
+	if (!block) {
+		return nullptr;
+	}
+
+	*reinterpret_cast<std::size_t*>(block) = size;
+	live_bytes += size;
+	return block + header;
+}
+
+void* operator new(std::size_t size)
+{
+	if (void* p = operator new(size, std::nothrow)) {
+		return p;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	if (p) {
+		auto block = static_cast<char*>(p) - header;
+		live_bytes -= *reinterpret_cast<std::size_t*>(block);
+		std::free(block);
+	}
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+#endif
 
 template<class T>
 void print_list(const T& l)
@@ -15,6 +82,14 @@ void print_list(const T& l)
 	}
 
 	assert(s == l.size());
+
+	// Walk back as well, to catch broken prev links.
+	s = 0;
+	for (auto it = l.rbegin(); it != l.rend(); ++it) {
+		++s;
+	}
+
+	assert(s == l.size());
 }
 
 template<class T>
@@ -63,6 +138,13 @@ void test_compare()
 	assert(t1 <= t2);
 	assert(t2 > t1);
 	assert(t2 >= t1);
+
+	T t3 = {1, 3};
+	T t4 = {1, 2};
+	assert(!(t3 == t4));
+	assert(!(t3 <= t4));
+	assert(!(t4 >= t3));
+	assert(t3 <= t3 && t3 >= t3);
 }
 
 template<class T>
@@ -116,6 +198,34 @@ void test_constructors()
 	print_list(t2);
 }
 
+template<class T>
+void test_assign()
+{
+	std::cout << "Testing assignment" << std::endl;
+
+	const T source = {1, 2, 3, 4, 5, 6};
+	T t = {9, 9, 9};
+
+	// Growing, shrinking and same-size assignment.
+	t = source;
+	print_list(t);
+	t.assign(3, 7);
+	print_list(t);
+	t.assign({4, 5, 6});
+	print_list(t);
+	t.assign(source.begin(), source.end());
+	print_list(t);
+	t.assign(8, 1);
+	print_list(t);
+	t.assign(0, 1);
+	print_list(t);
+
+	T empty;
+	t = source;
+	t = empty;
+	print_list(t);
+}
+
 template<class T>
 void test_pop()
 {
@@ -172,6 +282,211 @@ void test_sorting()
 	print_list(t);
 }
 
+// std::list has no key sort; the reference compares the keys instead.
+template<class T, class KeyFunction>
+void sort_by_key(std::list<T>& l, KeyFunction key)
+{
+	l.sort([&key](const T& a, const T& b) { return key(a) < key(b); });
+}
+
+template<class T, class KeyFunction>
+void sort_by_key(safelist<T>& l, KeyFunction key)
+{
+	l.sort_by_key(key);
+}
+
+template<class T>
+void test_sort_by_key()
+{
+	std::cout << "Testing key sorting" << std::endl;
+
+	// Sorting on tens only shows whether the sort is stable.
+	T t = {31, -7, 4000, 12, -300, 35, 0, 17, -12, 1 << 30, -(1 << 30), 39};
+	sort_by_key(t, [](int a) { return a / 10; });
+	print_list(t);
+
+	sort_by_key(t, [](int a) { return static_cast<unsigned char>(a); });
+	print_list(t);
+
+	// Non-integral keys use a comparison sort.
+	sort_by_key(t, [](int a) { return std::to_string(a); });
+	print_list(t);
+}
+
+// std::list has no split_at or partition members; the reference splices
+// and uses the algorithms.
+template<class T>
+std::list<T> split_at(std::list<T>& l, typename std::list<T>::iterator pos)
+{
+	std::list<T> tail;
+	tail.splice(tail.end(), l, pos, l.end());
+	return tail;
+}
+
+template<class T>
+safelist<T> split_at(safelist<T>& l, typename safelist<T>::iterator pos)
+{
+	return l.split_at(pos);
+}
+
+template<class T, class UnaryPredicate>
+typename std::list<T>::iterator partition(std::list<T>& l, UnaryPredicate pred, bool stable)
+{
+	return stable ? std::stable_partition(l.begin(), l.end(), pred) : std::partition(l.begin(), l.end(), pred);
+}
+
+template<class T, class UnaryPredicate>
+typename safelist<T>::iterator partition(safelist<T>& l, UnaryPredicate pred, bool stable)
+{
+	return stable ? l.stable_partition(pred) : l.partition(pred);
+}
+
+// Nor does it have the hash based set operations; the reference searches
+// the lists instead.
+template<class T>
+void unique_unordered(std::list<T>& l)
+{
+	for (auto it = l.begin(); it != l.end(); ++it) {
+		const auto& v = *it;
+		l.remove_if([&v](const T& x) { return &x != &v && x == v; });
+	}
+}
+
+template<class T>
+void unique_unordered(safelist<T>& l)
+{
+	l.unique_unordered();
+}
+
+template<class T>
+void difference_with(std::list<T>& l, const std::list<T>& other)
+{
+	l.remove_if([&other](const T& x) { return std::find(other.begin(), other.end(), x) != other.end(); });
+}
+
+template<class T>
+void difference_with(safelist<T>& l, const safelist<T>& other)
+{
+	l.difference_with(other);
+}
+
+template<class T>
+void intersect_with(std::list<T>& l, const std::list<T>& other)
+{
+	l.remove_if([&other](const T& x) { return std::find(other.begin(), other.end(), x) == other.end(); });
+}
+
+template<class T>
+void intersect_with(safelist<T>& l, const safelist<T>& other)
+{
+	l.intersect_with(other);
+}
+
+template<class T>
+void union_with(std::list<T>& l, std::list<T>& other)
+{
+	for (auto it = other.begin(); it != other.end();) {
+		if (std::find(l.begin(), l.end(), *it) == l.end()) {
+			l.splice(l.end(), other, it++);
+		} else {
+			++it;
+		}
+	}
+}
+
+template<class T>
+void union_with(safelist<T>& l, safelist<T>& other)
+{
+	l.union_with(other);
+}
+
+template<class T>
+void test_set_operations()
+{
+	std::cout << "Testing hash based set operations" << std::endl;
+
+	T t = {5, 3, 5, 1, 3, 9, 1, 1, 7};
+	unique_unordered(t);
+	print_list(t);
+
+	t = {5, 3, 5, 1, 3, 9, 1, 1, 7};
+	t.reverse();
+	unique_unordered(t);
+	print_list(t);
+
+	T other = {1, 4, 9, 9, 2};
+	difference_with(t, other);
+	print_list(t);
+
+	t = {4, 2, 8, 2, 6, 1};
+	intersect_with(t, other);
+	print_list(t);
+	intersect_with(t, T());
+	print_list(t);
+
+	t = {3, 4};
+	union_with(t, other);
+	print_list(t);
+	print_list(other);
+
+	T empty;
+	union_with(empty, t);
+	print_list(empty);
+	print_list(t);
+	difference_with(empty, empty);
+	print_list(empty);
+}
+
+template<class T>
+void test_split_partition()
+{
+	std::cout << "Testing split and partition" << std::endl;
+
+	T t = {4, 9, 1, 6, 6, 3, 8, 2, 7};
+	auto tail = split_at(t, std::next(t.begin(), 4));
+	print_list(t);
+	print_list(tail);
+
+	tail.reverse();
+	auto rest = split_at(tail, std::next(tail.begin()));
+	print_list(tail);
+	print_list(rest);
+	rest.push_back(5);
+	print_list(rest);
+
+	print_list(split_at(t, t.begin()));
+	print_list(t);
+	print_list(split_at(t, t.end()));
+
+	t = {4, 9, 1, 6, 6, 3, 8, 2, 7, 0};
+	auto is_even = [](int x) { return x % 2 == 0; };
+	auto it = partition(t, is_even, true);
+	print_list(t);
+	std::cout << std::distance(t.begin(), it) << std::endl;
+
+	// Order within the groups is unspecified for partition().
+	t.reverse();
+	it = partition(t, [](int x) { return x > 4; }, false);
+	std::cout << std::distance(t.begin(), it) << ' ' << std::is_partitioned(t.begin(), t.end(), [](int x) { return x > 4; }) << std::endl;
+	t.sort();
+	print_list(t);
+
+	t.reverse();
+	it = partition(t, [](int x) { return x < 3; }, true);
+	print_list(t);
+	print_list(split_at(t, it));
+	print_list(t);
+
+	it = partition(t, is_even, false);
+	std::cout << (it == t.end()) << std::endl;
+	it = partition(t, [](int) { return false; }, true);
+	std::cout << (it == t.begin()) << std::endl;
+	print_list(t);
+	it = partition(t, [](int x) { return x != 0; }, true);
+	print_list(t);
+	std::cout << *it << std::endl;
+}
+
 template<class T>
 void test_unique()
 {
@@ -201,6 +516,94 @@ void test_reverse()
 	print_list(t);
 }
 
+template<class T>
+void test_reversed_operations()
+{
+	std::cout << "Testing operations on reversed lists" << std::endl;
+
+	T t = {1, 2, 3, 4, 5};
+	auto it = ++t.begin();
+	t.reverse();
+
+	t.push_front(0);
+	t.push_back(6);
+	t.emplace_front(-1);
+	t.insert(++t.begin(), 10);
+	t.erase(--(--t.end()));
+	print_list(t);
+	test_access(t);
+	std::cout << *it << std::endl;
+
+	t.pop_front();
+	t.pop_back();
+	print_list(t);
+
+	// Iterators taken before a reversal move in the new direction.
+	T r = {1, 2, 3};
+	auto first = r.begin(), last = --r.end();
+	r.reverse();
+	std::cout << (++first == r.end()) << std::endl;
+	std::cout << *--first << std::endl;
+	std::cout << *++last << std::endl;
+	r.reverse();
+	std::cout << *++first << std::endl;
+	std::cout << *--last << std::endl;
+
+	// They follow their element into another list, also once the list
+	// it came from is gone.
+	T from = {1, 2, 3}, into = {10, 20, 30};
+	from.reverse();
+	auto moved = from.begin();
+	into.splice(std::next(into.begin()), from, moved);
+	for (auto j = moved; j != into.end(); ++j) {
+		std::cout << *j << std::endl;
+	}
+	into.reverse();
+	{
+		T gone = {4, 5};
+		gone.reverse();
+		moved = gone.begin();
+		into.splice(std::next(into.begin()), gone, moved);
+	}
+	for (auto j = moved; j != into.end(); ++j) {
+		std::cout << *j << std::endl;
+	}
+
+	// Splicing between lists that disagree on their orientation.
+	T t2 = {7, 8, 9};
+	t.splice(++t.begin(), t2, ++t2.begin());
+	t.splice(t.end(), t2);
+	print_list(t);
+	print_list(t2);
+
+	T t3 = {20, 21};
+	t3.reverse();
+	t3.splice(t3.begin(), t);
+	print_list(t3);
+	t3.splice(t3.end(), t3, t3.begin());
+	print_list(t3);
+
+	t = t3;
+	t.reverse();
+	t.reverse();
+	t.reverse();
+	for (auto rit = t.rbegin(); rit != t.rend(); ++rit) {
+		std::cout << *rit << std::endl;
+	}
+
+	t.sort();
+	print_list(t);
+	t.reverse();
+	t.unique([](int a, int b) { return a / 5 == b / 5; });
+	print_list(t);
+
+	T t4 = {3, 1};
+	t4.reverse();
+	t.reverse();
+	t.merge(t4);
+	print_list(t);
+}
+
 template<class T>
 void test_remove()
 {
@@ -227,6 +630,45 @@ void test_merge()
 	print_list(t2);
 }
 
+// std::list has no k-way merge, so the reference merges pairwise.
+template<class T, class Compare>
+void merge_all(std::list<T>& l, std::vector<std::list<T>>& lists, Compare comp)
+{
+	for (auto& other : lists) {
+		l.merge(other, comp);
+	}
+}
+
+template<class T, class Compare>
+void merge_all(safelist<T>& l, std::vector<safelist<T>>& lists, Compare comp)
+{
+	l.merge_all(lists, comp);
+}
+
+template<class T>
+void test_merge_all()
+{
+	std::cout << "Testing k-way merge" << std::endl;
+
+	T t = {10, 20, 30};
+	std::vector<T> lists = {{1, 11, 21}, {}, {12, 22, 32, 42}, {0, 13, 14}};
+
+	// Compare on tens only, so that ties show whether the merge is stable.
+	auto tens = [](int a, int b) { return a / 10 < b / 10; };
+	merge_all(t, lists, tens);
+
+	print_list(t);
+	for (auto& l : lists) {
+		print_list(l);
+		l.push_back(5);
+		print_list(l);
+	}
+
+	T empty;
+	merge_all(empty, lists, tens);
+	print_list(empty);
+}
+
 template<class T>
 void test_insert()
 {
@@ -253,6 +695,92 @@ void test_splice()
 	t1.splice(t1.end(), t3, t3.begin(), t3.end());
 	print_list(t1);
 	print_list(t3);
+
+	// Moving an element onto itself or its successor is a no-op.
+	t1.splice(t1.begin(), t1, t1.begin());
+	t1.splice(++t1.begin(), t1, t1.begin());
+	t1.splice(t1.begin(), t1, --t1.end());
+	print_list(t1);
+}
+
+template<class T>
+void test_views()
+{
+	using namespace safelist_views;
+	std::cout << "Testing views" << std::endl;
+
+	T t = {1, 2, 3, 4, 5, 6, 7, 8};
+	auto is_even = [](int x) { return x % 2 == 0; };
+	auto square = [](int x) { return x * x; };
+
+	for (auto x : t | filter(is_even) | transform(square)) {
+		std::cout << x << ' ';
+	}
+	std::cout << std::endl;
+
+	auto odd_tail = t | drop(2) | filter([](int x) { return x % 2 != 0; });
+	for (auto it = odd_tail.end(); it != odd_tail.begin();) {
+		std::cout << *--it << ' ';
+	}
+	std::cout << std::endl;
+
+	// Views write through to the list.
+	for (auto& x : t | drop(5) | take(2)) {
+		x = -x;
+	}
+	for (auto x : t | take(20)) {
+		std::cout << x << ' ';
+	}
+	std::cout << std::endl;
+
+	// Views are copyable and assignable, lambdas and all.
+	auto evens = t | filter(is_even);
+	auto copy = evens;
+	copy = evens;
+	std::cout << std::distance(copy.begin(), copy.end()) << std::endl;
+
+	// The first match is only searched for once.
+	int calls = 0;
+	auto late = t | filter([&calls](int x) { ++calls; return x > 4; });
+	assert(*late.begin() == 5);
+	const auto searched = calls;
+	assert(*late.begin() == 5 && late.begin() != late.end());
+	assert(calls == searched);
+}
+
+template<class T>
+void test_move()
+{
+	std::cout << "Testing moved-from and empty lists" << std::endl;
+
+	T t1 = {1, 2, 3};
+	T t2(std::move(t1));
+	print_list(t2);
+
+	// A moved-from list must be empty and fully usable.
+	std::cout << t1.size() << std::endl;
+	t1.clear();
+	t1.push_back(4);
+	t1.push_front(3);
+	print_list(t1);
+
+	t2 = std::move(t1);
+	print_list(t2);
+	t1.splice(t1.end(), t2);
+	print_list(t1);
+
+	// Operations on a list that never held an element.
+	T t3;
+	t3.sort();
+	t3.reverse();
+	t3.remove(1);
+	t3.merge(t1);
+	print_list(t3);
+
+	T t4;
+	t4.insert(t4.end(), 5);
+	t4.emplace(t4.begin(), 6);
+	print_list(t4);
 }
 
 template<class T>
@@ -265,27 +793,1444 @@ void test()
 	test_iters((const T) t);
 
 	test_constructors<T>();
+	test_emplace<T>();
+	test_insert<T>();
+	test_assign<T>();
 
 	test_access(t);
 	test_access((const T) t);
+	test_compare<T>();
 
 	test_pop<T>();
 	test_sizing<T>();
 	test_sorting<T>();
+	test_sort_by_key<T>();
+	test_split_partition<T>();
+	test_set_operations<T>();
 	test_erase<T>();
 	test_unique<T>();
 	test_reverse<T>();
+	test_reversed_operations<T>();
 	test_remove<T>();
 	test_merge<T>();
+	test_merge_all<T>();
 	test_splice<T>();
+	test_move<T>();
+	test_views<T>();
+}
+
+template<class T>
+void print_forward_list(const T& l)
+{
+	for (auto x : l) {
+		std::cout << x << ' ';
+	}
+	std::cout << std::endl;
+}
+
+template<class T>
+void test_forward_list()
+{
+	std::cout << "Testing forward lists" << std::endl;
+
+	T t = {5, 3, 1};
+	t.push_front(4);
+	t.emplace_front(2);
+	t.insert_after(t.begin(), {7, 7, 8});
+	t.emplace_after(t.before_begin(), 9);
+	print_forward_list(t);
+
+	t.erase_after(t.begin());
+	t.erase_after(std::next(t.begin(), 2), std::next(t.begin(), 5));
+	print_forward_list(t);
+
+	T other = {6, 0, 6};
+	t.splice_after(t.before_begin(), other, other.begin());
+	t.splice_after(t.begin(), other);
+	print_forward_list(t);
+	print_forward_list(other);
+
+	t.sort();
+	print_forward_list(t);
+	t.unique();
+	t.remove(6);
+	print_forward_list(t);
+
+	other = {0, 2, 5, 10};
+	t.merge(other);
+	print_forward_list(t);
+	t.sort(std::greater<int>());
+	t.reverse();
+	print_forward_list(t);
+
+	t.remove_if([](int x) { return x % 2 == 0; });
+	t.resize(5, -1);
+	print_forward_list(t);
+	t.resize(2);
+	print_forward_list(t);
+
+	T copy(t);
+	copy.assign({4, 5, 6});
+	t = copy;
+	t.pop_front();
+	print_forward_list(t);
+	std::cout << (t == copy) << (t != copy) << (copy < t) << (t <= copy) << std::endl;
+
+	T moved(std::move(copy));
+	print_forward_list(moved);
+	std::cout << copy.empty() << std::endl;
+	copy.push_front(1);
+	copy.clear();
+	print_forward_list(copy);
+}
+
+// Size and order-sensitive digests in both directions, for lists too long
+// to print.
+template<class T>
+void print_digest(const T& l)
+{
+	unsigned long long forward = 0, backward = 0;
+	for (auto it = l.begin(); it != l.end(); ++it) {
+		forward = forward * 31 + static_cast<unsigned long long>(*it);
+	}
+	for (auto it = l.rbegin(); it != l.rend(); ++it) {
+		backward = backward * 31 + static_cast<unsigned long long>(*it);
+	}
+
+	std::cout << l.size() << ' ' << forward << ' ' << backward << std::endl;
+}
+
+template<class T>
+void test_packed()
+{
+	std::cout << "Testing packed lists" << std::endl;
+
+	T t = {5, 7, 7, -3, 1LL << 40, 0};
+	t.push_front(-(1LL << 62));
+	t.push_back(std::numeric_limits<long long>::max());
+	t.push_back(std::numeric_limits<long long>::min());
+	print_forward_list(t);
+
+	// Enough elements for many chunks, with differences of every size.
+	for (long long i = 0; i < 3000; ++i) {
+		t.push_back(i % 7 ? i : static_cast<long long>(static_cast<unsigned long long>(i) << (i % 60)));
+		t.push_front(-i);
+	}
+	print_digest(t);
+
+	auto it = t.insert(std::next(t.begin(), 500), 42);
+	std::cout << *it << ' ' << *std::next(it) << ' ' << *std::prev(it) << std::endl;
+	for (long long i = 0; i < 400; ++i) {
+		it = t.insert(it, i * 1000003);
+	}
+	print_digest(t);
+
+	int k = 0;
+	for (it = t.begin(); it != t.end();) {
+		if (k++ % 3 == 0) {
+			it = t.erase(it);
+		} else {
+			++it;
+		}
+	}
+	print_digest(t);
+
+	// Growing differences through assignment splits chunks under the
+	// iterator.
+	k = 0;
+	for (it = t.begin(); it != t.end(); ++it) {
+		if (k % 4 == 0) {
+			*it = *it ^ (1LL << 55);
+		} else if (k % 4 == 1) {
+			*it = *it / 2;
+		} else {
+			*it -= *it / 4;
+		}
+		++k;
+	}
+	print_digest(t);
+
+	t.erase(std::next(t.begin(), 10), std::next(t.begin(), 2400));
+	for (int i = 0; i < 5; ++i) {
+		t.pop_front();
+		t.pop_back();
+	}
+	std::cout << t.front() << ' ' << t.back() << std::endl;
+	print_digest(t);
+
+	T copy(t);
+	std::cout << (copy == t) << (copy < t) << std::endl;
+	*std::next(copy.begin(), 100) = 1;
+	std::cout << (copy == t) << (copy < t) << (t < copy) << std::endl;
+
+	T moved(std::move(copy));
+	copy = moved;
+	moved.clear();
+	print_digest(moved);
+	print_digest(copy);
+}
+
+void test_packed_safelist()
+{
+	typedef packed_safelist<unsigned> list;
+
+	list l;
+	assert(l.begin() == l.end());
+	for (unsigned i = 0; i < 1000; ++i) {
+		l.push_back(i);
+	}
+
+	// Appending and assigning leave other iterators in place.
+	auto it = std::next(l.begin(), 150);
+	auto before = std::prev(it);
+	l.push_back(1000);
+	*before = 1u << 31;
+	assert(*it == 150 && *--it == 1u << 31 && *--it == 148);
+
+	// Iterators into a removed chunk stop working, safely.
+	l.clear();
+	bool threw = false;
+	try {
+		*it;
+	} catch (const std::range_error&) {
+		threw = true;
+	}
+	assert(threw);
+	++it;
+	assert(it == list::iterator());
+
+	threw = false;
+	try {
+		*l.end();
+	} catch (const std::range_error&) {
+		threw = true;
+	}
+	assert(threw);
+
+	// Unsigned wraparound is just another difference.
+	l = {0, ~0u, 1, ~0u - 1};
+	assert(*std::next(l.begin(), 3) == ~0u - 1 && *std::prev(l.end(), 3) == ~0u);
+
+	packed_safelist<signed char> small = {-128, 127, 0, -128};
+	assert(small.back() == -128 && *++small.begin() == 127);
+}
+
+// Hashes like std::hash, but throws once hash_budget reaches zero.
+static int hash_budget = -1;
+
+struct budget_hash
+{
+	std::size_t operator()(int key) const
+	{
+		if (hash_budget == 0) {
+			throw std::runtime_error("hash");
+		}
+
+		--hash_budget;
+		return key;
+	}
+};
+
+// Containers built on safelist have no std counterpart, so they are
+// checked with assertions and print nothing.
+void test_lru_cache()
+{
+	safe_lru_cache<int, int> cache(3);
+	for (int i = 0; i < 3; ++i) {
+		cache.put(i, i * 10);
+	}
+
+	// Touch 0 so that 1 becomes the least recently used entry.
+	assert(cache.find(0)->second == 0);
+	cache.put(3, 30);
+
+	assert(cache.size() == 3);
+	assert(cache.evictions() == 1);
+	assert(cache.find(1) == cache.end());
+	assert(cache.peek(2)->second == 20);
+	assert(cache.begin()->first == 3);
+
+	cache.put(2, 21);
+	assert(cache.begin()->second == 21);
+	assert(cache.erase(2));
+	assert(!cache.erase(2));
+	assert(cache.size() == 2);
+
+	// Weighted capacity: values weigh their own size.
+	struct by_value {
+		std::size_t operator()(int, int v) const { return v; }
+	};
+	safe_lru_cache<int, int, by_value> weighted(10);
+	weighted.put(1, 4);
+	weighted.put(2, 4);
+	weighted.put(3, 4);
+	assert(weighted.size() == 2);
+	assert(weighted.weight() == 8);
+	assert(!weighted.count(1));
+
+	// A failed insertion into the index leaves no node behind.
+	safe_lru_cache<int, int, lru_unit_weight<int, int>, budget_hash> picky(2);
+	picky.put(1, 10);
+	hash_budget = 1;
+	try {
+		picky.put(2, 20);
+		assert(false);
+	} catch (const std::runtime_error&) {
+	}
+	hash_budget = -1;
+	assert(picky.size() == 1 && picky.weight() == 1);
+	picky.put(3, 30);
+	picky.put(4, 40);
+	assert(picky.size() == 2 && !picky.count(1));
+}
+
+struct by_id;
+struct by_age;
+
+struct hooked : intrusive_hook<by_id>, intrusive_hook<by_age>
+{
+	int id;
+
+	explicit hooked(int id): id(id) {}
+};
+
+#if __cplusplus >= 202002L
+// The iterators and views model the C++20 range concepts.
+static_assert(std::bidirectional_iterator<safelist<int>::iterator>);
+static_assert(std::bidirectional_iterator<safelist<int>::const_iterator>);
+static_assert(std::ranges::bidirectional_range<safelist<int>>);
+static_assert(std::forward_iterator<safe_forward_list<int>::iterator>);
+static_assert(std::bidirectional_iterator<intrusive_safelist<hooked, by_id>::iterator>);
+
+using even_view = decltype(std::declval<safelist<int>&>() | safelist_views::filter([](int x) { return x % 2 == 0; }));
+using square_view = decltype(std::declval<even_view>() | safelist_views::transform([](int x) { return x * x; }));
+static_assert(std::ranges::view<even_view> && std::ranges::bidirectional_range<even_view>);
+static_assert(std::ranges::view<square_view> && std::ranges::bidirectional_range<square_view>);
+static_assert(std::ranges::forward_range<decltype(std::declval<square_view>() | safelist_views::take(2))>);
+static_assert(std::ranges::bidirectional_range<decltype(std::declval<square_view>() | safelist_views::drop(2))>);
+#endif
+
+void test_intrusive_safelist()
+{
+	typedef intrusive_safelist<hooked, by_id> id_list;
+	typedef intrusive_safelist<hooked, by_age> age_list;
+
+	hooked a(1), b(2), c(3);
+	id_list ids;
+	age_list ages;
+	ids.push_back(a);
+	ids.push_back(b);
+	ids.push_back(c);
+	ages.push_front(a);
+	ages.push_front(c);
+
+	assert(ids.size() == 3 && ages.size() == 2);
+	assert(ids.front().id == 1 && ids.back().id == 3);
+	assert(ages.front().id == 3);
+
+	bool threw = false;
+	try {
+		ids.push_back(b);
+	} catch (const std::logic_error&) {
+		threw = true;
+	}
+	assert(threw);
+
+	// Destroying an element takes it off every list and detaches
+	// iterators to it.
+	id_list::iterator stale;
+	{
+		hooked d(4);
+		ids.insert(ids.iterator_to(b), d);
+		ages.push_back(d);
+		stale = ids.iterator_to(d);
+		assert(stale->id == 4 && ids.size() == 4);
+	}
+	assert(ids.size() == 3 && ages.size() == 2);
+	assert(stale == id_list::iterator());
+
+	threw = false;
+	try {
+		++stale;
+	} catch (const std::range_error&) {
+		threw = true;
+	}
+	assert(threw);
+
+	// Erasing detaches only the erased element's iterators.
+	auto first = ids.begin();
+	auto second = std::next(first);
+	auto next = ids.erase(first);
+	assert(next == second && next->id == 2);
+	assert(first == id_list::iterator());
+	assert(!static_cast<intrusive_hook<by_id>&>(a).is_linked());
+	assert(static_cast<intrusive_hook<by_age>&>(a).is_linked());
+
+	// Splicing keeps iterators valid.
+	id_list others;
+	others.splice(others.end(), ids, second);
+	assert(second->id == 2 && others.size() == 1 && ids.size() == 1);
+	others.splice(others.begin(), ids);
+	assert(ids.empty() && others.front().id == 3);
+
+	int expected = 2;
+	for (auto it = others.rbegin(); it != others.rend(); ++it) {
+		assert(it->id == expected++);
+	}
+
+	ages.remove_if([](const hooked& h) { return h.id == 3; });
+	assert(ages.size() == 1 && ages.front().id == 1);
+
+	// A moved list keeps its elements, and clearing leaves them alive.
+	id_list moved(std::move(others));
+	assert(others.empty() && moved.size() == 2);
+	moved.clear();
+	assert(c.id == 3 && !static_cast<intrusive_hook<by_id>&>(c).is_linked());
+}
+
+// Checks that the incrementally maintained hash matches a fresh one. The
+// pair sums only show through ==, which rejects the lists if they differ.
+void expect_hash_up_to_date(safelist<int>& l)
+{
+	safelist<int> fresh(l.begin(), l.end());
+	fresh.enable_hash();
+	assert(l.hash() == fresh.hash() && l == fresh);
+}
+
+void test_content_hash()
+{
+	safelist<int> a = {3, 1, 2};
+	safelist<int> b;
+	b.enable_hash();
+	a.enable_hash();
+	expect_hash_up_to_date(a);
+
+	a.push_back(5);
+	a.push_front(4);
+	a.insert(++a.begin(), 7);
+	a.erase(--a.end());
+	a.pop_front();
+	expect_hash_up_to_date(a);
+
+	a.reverse();
+	a.push_back(9);
+	expect_hash_up_to_date(a);
+
+	// Order matters, and the walk is only needed when the hashes agree.
+	b = {2, 1, 7, 3};
+	assert(b.hash() != a.hash());
+	b.assign({2, 1, 3, 7, 9});
+	assert(b.hash() == a.hash() && b == a);
+
+	// Swapping runs between repeated values keeps the same neighbours.
+	safelist<int> runs = {1, 2, 1, 3, 1}, swapped = {1, 3, 1, 2, 1};
+	runs.enable_hash();
+	swapped.enable_hash();
+	assert(runs.hash() != swapped.hash() && runs != swapped);
+	runs.reverse();
+	assert(runs.hash() == swapped.hash() && runs == swapped);
+
+	a.sort();
+	expect_hash_up_to_date(a);
+	a.splice(a.begin(), b, --b.end());
+	b.splice(b.end(), a);
+	expect_hash_up_to_date(a);
+	expect_hash_up_to_date(b);
+
+	// Lists that do not track a hash can still be spliced in.
+	safelist<int> plain = {8, 6};
+	b.splice(++b.begin(), plain);
+	b.merge(a);
+	b.unique();
+	expect_hash_up_to_date(b);
+	b.sort_by_key([](int x) { return -x; });
+	expect_hash_up_to_date(b);
+
+	auto tail = b.split_at(std::next(b.begin(), 2));
+	assert(tail.hash_enabled());
+	expect_hash_up_to_date(tail);
+	b.partition([](int x) { return x % 2 == 0; });
+	tail.stable_partition([](int x) { return x > 3; });
+	expect_hash_up_to_date(b);
+	expect_hash_up_to_date(tail);
+	auto node = b.extract(b.begin());
+	node.value() = 42;
+	tail.insert(tail.end(), std::move(node));
+	expect_hash_up_to_date(b);
+	expect_hash_up_to_date(tail);
+	tail.push_back(42);
+	tail.unique_unordered();
+	b.union_with(tail);
+	expect_hash_up_to_date(b);
+	expect_hash_up_to_date(tail);
+	b.difference_with(safelist<int>{42});
+	tail.intersect_with(b);
+	expect_hash_up_to_date(b);
+	expect_hash_up_to_date(tail);
+	b.splice(b.end(), tail);
+
+	safelist<int> c(b);
+	assert(c.hash_enabled() && c.hash() == b.hash());
+	c.front() = 100;
+	c.rehash();
+	assert(c != b);
+
+	// Moves take the setting along, so std::swap keeps it on both lists.
+	safelist<int> d = {1, 2};
+	std::swap(c, d);
+	assert(!c.hash_enabled() && d.hash_enabled());
+	expect_hash_up_to_date(d);
+	c = std::move(d);
+	assert(c.hash_enabled() && !d.hash_enabled());
+	expect_hash_up_to_date(c);
+
+	b.clear();
+	safelist<int> empty;
+	empty.enable_hash();
+	assert(b.hash() == empty.hash());
+}
+
+// Relinking the entries leaves iterators walking in the same order.
+void test_normalize()
+{
+	safelist<int> l = {1, 2, 3, 4};
+	auto it = ++l.begin();
+	const auto end = l.end();
+	l.reverse();
+	l.normalize();
+	assert(*it == 2 && *++it == 1 && ++it == end);
+	l.reverse();
+	assert(*--it == 4 && *--it == 3);
+}
+
+void test_deferred_reclaim()
+{
+	typedef safelist<int> list;
+
+	const auto before = live_bytes;
+	{
+		list::reclaimer r;
+		list l;
+		l.set_reclaimer(&r);
+		for (int i = 0; i < 1000; ++i) {
+			l.push_back(i);
+		}
+
+		// Clearing only detaches the entries, which stay reachable from
+		// iterators until they are freed.
+		auto it = std::next(l.begin(), 500);
+		const auto full = live_bytes;
+		l.clear();
+		assert(l.empty() && r.pending());
+		assert(live_bytes > full - 1000 * sizeof(int));
+		assert(*it == 500 && *++it == 501);
+
+		// Calls that change the list reject them, though.
+		int failures = 0;
+		const auto expect_range_error = [&failures](std::function<void()> f) {
+			try {
+				f();
+			} catch (const std::range_error&) {
+				++failures;
+			}
+		};
+		list spare;
+		expect_range_error([&] { l.erase(it); });
+		expect_range_error([&] { l.erase(it, l.end()); });
+		expect_range_error([&] { l.insert(it, 42); });
+		expect_range_error([&] { l.emplace(it, 42); });
+		expect_range_error([&] { l.extract(it); });
+		expect_range_error([&] { spare.splice(spare.end(), l, it); });
+		expect_range_error([&] { l.split_at(it); });
+		assert(failures == 7);
+		assert(l.empty() && spare.empty() && *it == 501);
+
+		assert(r.reclaim(100) == 100);
+		assert(*it == 501);
+		assert(r.reclaim(10000) == 900);
+		assert(!r.pending() && r.reclaim(1) == 0);
+		assert(it == list::iterator());
+
+		// Erasing a range keeps the entries linked to what follows it,
+		// in either orientation, and keeps the hash up to date.
+		l.enable_hash();
+		for (int reversed = 0; reversed < 2; ++reversed) {
+			l.assign({0, 1, 2, 3, 4, 5, 6});
+			if (reversed) {
+				l.reverse();
+			}
+
+			auto first = std::next(l.begin(), 2);
+			auto stale = std::next(first);
+			const auto last = std::next(first, 3);
+			assert(l.erase(first, last) == last);
+			assert(l.size() == 4);
+			expect_hash_up_to_date(l);
+			expect_range_error([&] { l.erase(stale); });
+			expect_range_error([&] { l.insert(stale, 42); });
+			assert(l.size() == 4);
+			expect_hash_up_to_date(l);
+			assert(*++++stale == *last);
+			assert(l.erase(l.begin(), l.begin()) == l.begin() && l.size() == 4);
+		}
+		l.reverse();
+		assert((l == list{0, 1, 5, 6}));
+		assert(failures == 7 + 2 * 2);
+		r.reclaim(10);
+
+		bool threw = false;
+		try {
+			l.erase(l.end(), l.begin());
+		} catch (const std::range_error&) {
+			threw = true;
+		}
+		assert(threw && l.size() == 4);
+
+		// Lists hand over their entries when they are destroyed or
+		// assigned to, and the setting goes along with moves.
+		list other = {7, 8, 9};
+		other.set_reclaimer(&r);
+		l = std::move(other);
+		{
+			list moved(std::move(l));
+			assert(moved.get_reclaimer() == &r && !l.get_reclaimer());
+		}
+		// The sentinels of both lists went along with their elements.
+		assert(r.reclaim(100) == 4 + 3 + 2);
+
+		// What is left is freed along with the reclaimer.
+		list last(100);
+		last.set_reclaimer(&r);
+		last.clear();
+	}
+	assert(live_bytes == before);
+}
+
+void test_node_handles()
+{
+	typedef safelist<std::string> list;
+
+	list a = {"one", "two", "three"}, b;
+	auto it = ++a.begin();
+	std::string* value = &*it;
+
+	auto node = a.extract(it);
+	assert(!node.empty() && node);
+	assert(a.size() == 2 && a.front() == "one" && a.back() == "three");
+
+	// The value can be rewritten while the node is out of any list, and
+	// stays in place.
+	node.value() = "deux";
+	assert(&node.value() == value);
+
+	auto pos = b.insert(b.end(), std::move(node));
+	assert(node.empty() && !node);
+	assert(b.size() == 1 && &*pos == value);
+	assert(it == pos && *it == "deux");
+
+	// Moving between orientations.
+	b.push_back("trois");
+	b.reverse();
+	b.insert(b.begin(), a.extract(a.begin()));
+	assert((b == list{"one", "trois", "deux"}));
+	assert((a == list{"three"}));
+
+	// Handles can be kept, swapped and dropped; dropping one frees the
+	// element.
+	list::node_type kept = b.extract(--b.end()), other;
+	kept.swap(other);
+	assert(kept.empty() && other.value() == "deux");
+	assert(b.insert(b.begin(), std::move(kept)) == b.begin());
+	assert(b.size() == 2);
+	other = list::node_type();
+	assert(it == list::iterator());
+
+	bool threw = false;
+	try {
+		a.extract(a.end());
+	} catch (const std::range_error&) {
+		threw = true;
+	}
+	assert(threw);
+
+	threw = false;
+	try {
+		kept.value();
+	} catch (const std::logic_error&) {
+		threw = true;
+	}
+	assert(threw);
+
+	// An iterator to an extracted element is in no list, so it is no
+	// position to insert at or split at, nor anything to erase or extract
+	// again.
+	list c = {"x", "y"};
+	auto at = c.begin();
+	auto held = c.extract(at);
+	int failures = 0;
+	const auto expect_range_error = [&failures](std::function<void()> f) {
+		try {
+			f();
+		} catch (const std::range_error&) {
+			++failures;
+		}
+	};
+	expect_range_error([&] { c.insert(at, std::move(held)); });
+	expect_range_error([&] { c.insert(at, "z"); });
+	expect_range_error([&] { c.erase(at); });
+	expect_range_error([&] { c.extract(at); });
+	expect_range_error([&] { a.splice(a.end(), c, at); });
+	expect_range_error([&] { c.split_at(at); });
+	assert(failures == 6);
+	assert(!held.empty() && (c == list{"y"}) && (a == list{"three"}));
+	c.insert(c.end(), std::move(held));
+	assert((c == list{"y", "x"}));
+}
+
+// Compares like std::less, but throws once it has been called calls times.
+struct throwing_less
+{
+	int* calls;
+
+	bool operator()(int a, int b) const
+	{
+		if (--*calls < 0) {
+			throw std::runtime_error("compare");
+		}
+
+		return a < b;
+	}
+};
+
+// Checks that l holds the expected elements in some order, and that its
+// links agree with its size both ways.
+void expect_same_elements(const safelist<int>& l, std::vector<int> expected)
+{
+	std::vector<int> seen(l.begin(), l.end());
+	assert(seen.size() == l.size());
+
+	std::size_t back = 0;
+	for (auto it = l.rbegin(); it != l.rend(); ++it) {
+		++back;
+	}
+	assert(back == l.size());
+
+	std::sort(seen.begin(), seen.end());
+	std::sort(expected.begin(), expected.end());
+	assert(seen == expected);
+}
+
+// A comparator that throws leaves the elements in place, if not in order.
+void test_throwing_compare()
+{
+	for (int n : {100, 400000}) {
+		std::vector<int> values;
+		for (int i = 0; i < n; ++i) {
+			values.push_back(i % 1000 * 7919 % 1000);
+		}
+
+		for (int limit : {0, 50, n, n * 3}) {
+			safelist<int> l(values.begin(), values.end());
+			int calls = limit;
+			try {
+				l.sort(throwing_less{&calls});
+				assert(false);
+			} catch (const std::runtime_error&) {
+			}
+			expect_same_elements(l, values);
+		}
+	}
+
+	// merge_all() keeps whatever it has not merged in this list.
+	for (int limit = 0; limit < 12; ++limit) {
+		safelist<int> out = {0, 7};
+		std::vector<safelist<int>> lists = {{1, 3, 5}, {2, 4, 6}};
+		int calls = limit;
+		try {
+			out.merge_all(lists, throwing_less{&calls});
+			assert(false);
+		} catch (const std::runtime_error&) {
+		}
+		expect_same_elements(out, {0, 1, 2, 3, 4, 5, 6, 7});
+		assert(lists[0].empty() && lists[1].empty());
+	}
+
+	// As do safe_forward_list's sort() and merge().
+	std::vector<int> values;
+	for (int i = 0; i < 100; ++i) {
+		values.push_back(i % 1000 * 7919 % 1000);
+	}
+	const auto expect_forward = [](const safe_forward_list<int>& l, std::vector<int> expected) {
+		std::vector<int> seen(l.begin(), l.end());
+		std::sort(seen.begin(), seen.end());
+		std::sort(expected.begin(), expected.end());
+		assert(seen == expected);
+	};
+	for (int limit : {0, 50, 100, 300}) {
+		safe_forward_list<int> l(values.begin(), values.end());
+		int calls = limit;
+		try {
+			l.sort(throwing_less{&calls});
+			assert(false);
+		} catch (const std::runtime_error&) {
+		}
+		expect_forward(l, values);
+
+		safe_forward_list<int> other(values.begin(), values.end());
+		l.sort();
+		other.sort();
+		calls = limit / 3;
+		try {
+			l.merge(other, throwing_less{&calls});
+			assert(false);
+		} catch (const std::runtime_error&) {
+		}
+		assert(other.empty());
+		auto both = values;
+		both.insert(both.end(), values.begin(), values.end());
+		expect_forward(l, both);
+	}
+}
+
+void test_defragment()
+{
+	// Interleave two lists so that neither has neighbouring entries.
+	safelist<int> l, other;
+	for (int i = 0; i < 100; ++i) {
+		l.push_back(i);
+		for (int j = 0; j < 4; ++j) {
+			other.push_back(j);
+		}
+	}
+	l.reverse();
+
+	int& first = l.front();
+	auto stale = ++l.begin();
+	auto end = l.end();
+	assert(l.layout().links == 99);
+	assert(l.layout().fragmentation() > 0.5);
+
+	l.defragment();
+	assert(l.layout().fragmentation() == 0);
+	assert(l.size() == 100);
+	assert(&l.front() == &first);
+	assert(end == l.end());
+
+	// Iterators into the old entries expire instead of dangling.
+	assert(stale == safelist<int>::iterator());
+
+	int expected = 99;
+	for (auto x : l) {
+		assert(x == expected--);
+	}
+	for (auto it = l.rbegin(); it != l.rend(); ++it) {
+		assert(*it == ++expected);
+	}
+
+	// The block outlives the list's use of it.
+	l.erase(l.begin());
+	l.push_front(100);
+	safelist<int> moved(std::move(l));
+	moved.sort();
+	assert(moved.front() == 0 && moved.back() == 100);
+}
+
+// Runs f and checks that it allocates exactly the expected number of blocks.
+template<class F>
+void expect_allocations(const char* what, std::size_t expected, F f)
+{
+	const auto before = allocations;
+	f();
+	const auto actual = allocations - before;
+
+	if (actual != expected) {
+		std::cerr << what << ": expected " << expected << " allocations, got " << actual << std::endl;
+		std::abort();
+	}
+}
+
+// Iterators outliving their elements may only keep a small control block
+// each allocated, not the nodes.
+void test_stale_iterator_memory()
+{
+	typedef safelist<int> list;
+
+	const std::size_t count = 1000;
+	const std::size_t tombstone = 4 * sizeof(void*);
+	std::vector<list::iterator> stale;
+	stale.reserve(count + 1);
+
+	auto before = live_bytes;
+	{
+		list l;
+		for (std::size_t i = 0; i < count; ++i) {
+			l.push_back(i);
+			stale.push_back(std::prev(l.end()));
+		}
+		stale.push_back(l.end());
+		assert(live_bytes - before > count * tombstone);
+
+		// Erase half of the elements one by one, and clear the rest.
+		for (std::size_t i = 0; i < count; i += 2) {
+			l.erase(stale[i]);
+		}
+		l.clear();
+		assert(live_bytes - before <= (count + 1) * tombstone);
+	}
+	assert(live_bytes - before <= (count + 1) * tombstone);
+	for (auto& it : stale) {
+		assert(it == list::iterator());
+	}
+
+	stale.clear();
+	assert(live_bytes == before);
+}
+
+void test_allocations()
+{
+	typedef safelist<int> list;
+
+	// A node is one block for the entry, one for its control block and
+	// one for the value. The sentinel has no value.
+	const std::size_t node = 3;
+	const std::size_t sentinel = 2;
+
+	list t;
+	expect_allocations("default constructor", 0, [] { list l; });
+	expect_allocations("first push_back", sentinel + node, [&] { t.push_back(1); });
+	expect_allocations("push_back", node, [&] { t.push_back(2); });
+	expect_allocations("push_front", node, [&] { t.push_front(0); });
+	expect_allocations("insert", node, [&] { t.insert(++t.begin(), 5); });
+	expect_allocations("emplace", node, [&] { t.emplace(t.end(), 3); });
+	expect_allocations("copy", sentinel + 5 * node, [&] { list copy(t); });
+
+	// Assignment reuses entries and only allocates for the surplus.
+	list target = {5, 4, 3, 2, 1, 0};
+	expect_allocations("copy assignment", 0, [&] { target = t; });
+	expect_allocations("assign", 2 * node, [&] { target.assign(7, 1); });
+	expect_allocations("shrinking assign", 0, [&] { target.assign({1, 2}); });
+
+	list t2 = {9, 8, 7, 6};
+	expect_allocations("iteration", 0, [&] {
+		for (auto& x : t2) {
+			++x;
+		}
+	});
+	expect_allocations("comparison", 0, [&] { return t == t2 || t < t2; });
+	expect_allocations("sort", 0, [&] { t.sort(); t2.sort(); });
+
+	// Key sorting allocates its buffers once, whatever the list size.
+	list t3(100, 1);
+	expect_allocations("sort_by_key", 3, [&] { t3.sort_by_key([](int a) { return a; }); });
+	expect_allocations("merge", 0, [&] { t.merge(t2); });
+	expect_allocations("partition", 0, [&] {
+		t.partition([](int a) { return a % 2 == 0; });
+		t.stable_partition([](int a) { return a > 4; });
+	});
+	expect_allocations("split_at", sentinel, [&] { list tail = t.split_at(std::next(t.begin(), 2)); t.splice(t.end(), tail); });
+	list other = {1};
+	expect_allocations("extract and insert", 0, [&] {
+		auto node = t.extract(t.begin());
+		node.value() = 10;
+		other.insert(other.begin(), std::move(node));
+		t.insert(t.end(), other.extract(other.begin()));
+	});
+	expect_allocations("reverse", 0, [&] { t.reverse(); t.normalize(); });
+	expect_allocations("unique", 0, [&] { t.unique(); });
+	expect_allocations("remove", 0, [&] { t.remove(5); });
+
+	t2 = {1, 2, 3};
+	expect_allocations("splice", 0, [&] {
+		t.splice(t.begin(), t2, t2.begin());
+		t.splice(t.end(), t2, t2.begin(), t2.end());
+		t2.splice(t2.end(), t);
+	});
+
+	expect_allocations("move", 0, [&] {
+		list moved(std::move(t2));
+		t = std::move(moved);
+		std::swap(t, t2);
+	});
+
+	expect_allocations("erase and pop", 0, [&] {
+		t2.erase(t2.begin());
+		t2.pop_back();
+		t2.pop_front();
+		t2.clear();
+	});
+
+	// The heap of list heads is the only allocation, apart from the
+	// sentinel that t gave away when it was swapped with a moved-from list.
+	std::vector<list> shards = {{1, 4}, {2, 5}, {3, 6}};
+	expect_allocations("merge_all", 1 + sentinel, [&] { t.merge_all(shards); });
+	assert(t.size() == 6);
+
+	hooked h1(1), h2(2);
+	intrusive_safelist<hooked, by_id> intrusive;
+	expect_allocations("intrusive insert and erase", 0, [&] {
+		intrusive.push_back(h1);
+		intrusive.push_front(h2);
+		for (auto& h : intrusive) {
+			h.id++;
+		}
+		intrusive.erase(intrusive.begin());
+		intrusive.clear();
+	});
+
+	// A forward list node is a single block, which holds the value.
+	safe_forward_list<int> forward;
+	expect_allocations("forward list first push_front", 1 + 1, [&] { forward.push_front(1); });
+	expect_allocations("forward list push_front", 1, [&] { forward.push_front(2); });
+	expect_allocations("forward list sort and reverse", 0, [&] { forward.sort(); forward.reverse(); });
+
+	list hashed;
+	hashed.enable_hash();
+	expect_allocations("hashed push_back", sentinel + node, [&] { hashed.push_back(1); });
+
+	// All entries go into a single block, with their control blocks
+	// apart; the values stay put.
+	expect_allocations("defragment", 1 + t.size(), [&] { t.defragment(); });
+
+	// One chunk per 193 neighbouring integers, plus the sentinel.
+	packed_safelist<long long> packed;
+	expect_allocations("packed push_back", 7, [&] {
+		for (int i = 0; i < 1000; ++i) {
+			packed.push_back(i);
+		}
+	});
+	expect_allocations("packed iteration", 0, [&] {
+		long long sum = 0;
+		for (auto x : packed) {
+			sum += x;
+		}
+		return sum;
+	});
+	expect_allocations("packed copy", 7, [&] { packed_safelist<long long> copy(packed); });
+}
+
+void test_rcu_safelist()
+{
+	rcu_safelist<int> l;
+	auto r = l.make_reader();
+
+	l.push_back(2);
+	l.push_front(1);
+	l.push_back(3);
+
+	int sum = 0;
+	r.for_each([&sum](int v) { sum += v; });
+	assert(sum == 6);
+	assert(l.size() == 3);
+
+	{
+		// Nodes removed while a reader is inside a guard stay readable.
+		auto guard = r.lock();
+		auto it = guard.begin();
+		l.remove(1);
+		l.pop_front();
+		assert(*it == 1);
+		assert(*++it == 2);
+		assert(l.retired() == 2);
+	}
+
+	l.reclaim();
+	assert(l.retired() == 0);
+	assert(l.size() == 1);
+
+	const int replacement[] = {7, 8, 9};
+	l.assign(replacement, replacement + 3);
+	l.remove_if([](int v) { return v == 9; });
+	l.push_back(10);
+
+	std::vector<int> seen;
+	r.for_each([&seen](int v) { seen.push_back(v); });
+	assert((seen == std::vector<int>{7, 8, 10}));
+
+	l.clear();
+	assert(l.empty());
+	auto guard = r.lock();
+	assert(guard.begin() == guard.end());
+}
+
+void test_sharded_safelist()
+{
+	typedef std::pair<int, char> record;
+	sharded_safelist<record> l;
+	assert(l.collect().empty());
+
+	auto a = l.make_appender();
+	{
+		auto b = l.make_appender();
+		a.push_back({1, 'a'});
+		b.push_back({2, 'b'});
+		a.emplace_back(3, 'a');
+		b.push_back({4, 'b'});
+	}
+	assert(l.segments() == 2);
+
+	// Segments are joined whole, in the order they were made.
+	auto all = l.collect();
+	assert((all == safelist<record>{{1, 'a'}, {3, 'a'}, {2, 'b'}, {4, 'b'}}));
+	assert(l.collect().empty());
+
+	// The segment of a destroyed appender is reused, and whatever was
+	// appended through it is still collected.
+	auto c = l.make_appender();
+	assert(l.segments() == 2);
+	c.push_back({6, 'c'});
+	a.push_back({5, 'a'});
+	a.push_back({8, 'a'});
+	c.push_back({7, 'c'});
+	{
+		auto moved = std::move(c);
+		moved.push_back({9, 'c'});
+	}
+
+	auto ordered = l.collect([](const record& x, const record& y) { return x.first < y.first; });
+	assert((ordered == safelist<record>{{5, 'a'}, {6, 'c'}, {7, 'c'}, {8, 'a'}, {9, 'c'}}));
+	assert(l.collect().empty());
+}
+
+void test_weak_observer_list()
+{
+	struct counter
+	{
+		int calls = 0;
+	};
+
+	weak_observer_list<counter> l(2);
+	std::vector<std::shared_ptr<counter>> alive;
+	std::vector<weak_observer_list<counter>::handle> handles;
+	for (int i = 0; i < 8; ++i) {
+		alive.push_back(std::make_shared<counter>());
+		handles.push_back(l.add(alive.back()));
+	}
+
+	const auto bump = [](counter& c) { ++c.calls; };
+	assert(l.notify(bump) == 8);
+
+	// Expired and removed observers are skipped, and pruned once there
+	// are enough of them.
+	alive[1].reset();
+	l.remove(handles[2]);
+	l.remove(handles[2]);
+	l.remove(alive[3]);
+	assert(l.dead() == 2);
+	assert(l.notify(bump) == 5);
+	assert(l.size() == 5 && l.dead() == 0);
+	assert(handles[1] == weak_observer_list<counter>::handle());
+	l.remove(handles[1]);
+	assert(alive[0]->calls == 2 && alive[3]->calls == 1);
+
+	// Observers may add and remove observers while being notified.
+	std::shared_ptr<counter> late;
+	l.notify([&](counter& c) {
+		++c.calls;
+		if (&c == alive[0].get()) {
+			l.remove(handles[4]);
+			l.remove(handles[5]);
+			late = std::make_shared<counter>();
+			l.add(late);
+		}
+		if (&c == alive[6].get()) {
+			alive[7].reset();
+			l.notify(bump);
+		}
+	});
+	assert(alive[0]->calls == 4 && alive[4]->calls == 2 && alive[6]->calls == 4);
+	assert(late->calls == 2);
+	assert(l.size() == 3 && l.dead() == 0);
+
+	// Below the threshold, nothing is pruned.
+	alive[6].reset();
+	assert(l.notify(bump) == 2);
+	assert(l.size() == 3 && l.dead() == 1);
+	l.compact();
+	assert(l.size() == 2 && l.dead() == 0);
+
+	// An observer may remove itself and compact the list while it is
+	// being notified; the pruning waits for the notification to end.
+	weak_observer_list<counter> w(100);
+	auto self = std::make_shared<counter>(), next = std::make_shared<counter>();
+	auto selfHandle = w.add(self);
+	w.add(next);
+	w.notify([&](counter& c) {
+		++c.calls;
+		if (&c == self.get()) {
+			w.remove(selfHandle);
+			w.compact();
+			assert(w.size() == 2);
+		}
+	});
+	assert(self->calls == 1 && next->calls == 1);
+	assert(w.size() == 1 && w.dead() == 0);
+}
+
+void test_timing_wheel()
+{
+	typedef timing_wheel<int> wheel;
+	wheel w;
+	std::vector<int> fired;
+	const auto record = [&](int v) { fired.push_back(v); };
+
+	// Deadlines on every level, and one past them all.
+	const std::vector<wheel::tick_type> deadlines = {3, 1, 255, 256, 300, 70000, 1 << 20, 1ull << 40, 3};
+	std::vector<wheel::handle> handles;
+	for (std::size_t i = 0; i < deadlines.size(); ++i) {
+		handles.push_back(w.schedule(deadlines[i], i));
+	}
+	assert(w.size() == deadlines.size());
+
+	assert(w.advance(3, record) == 3);
+	assert((fired == std::vector<int>{1, 0, 8}));
+	assert(w.now() == 3);
+
+	// Cancelling a fired timer, or one twice, does nothing.
+	assert(!w.cancel(handles[0]));
+	assert(w.cancel(handles[4]));
+	assert(!w.cancel(handles[4]));
+	assert(!w.cancel(wheel::handle()));
+	assert(w.size() == 5);
+
+	fired.clear();
+	std::vector<wheel::tick_type> at;
+	assert(w.advance((1ull << 40) + 10, [&](int v) {
+		fired.push_back(v);
+		at.push_back(w.now());
+	}) == 5);
+	assert((fired == std::vector<int>{2, 3, 5, 6, 7}));
+	for (std::size_t i = 0; i < fired.size(); ++i) {
+		assert(at[i] == deadlines[fired[i]]);
+	}
+	assert(w.empty() && w.now() == (1ull << 40) + 13);
+
+	// Every timer fires at its deadline, whichever slots it passes through
+	// on the way, starting just before level 1 and 2 wrap.
+	wheel spread(65530);
+	std::vector<wheel::tick_type> due;
+	for (int i = 0; i < 2000; ++i) {
+		due.push_back(65530 + (i * 7919ull) % 300000 + 1);
+		spread.schedule(due.back(), i);
+	}
+	std::size_t count = 0;
+	while (!spread.empty()) {
+		count += spread.advance(997, [&](int v) { assert(spread.now() == due[v]); });
+	}
+	assert(count == due.size());
+
+	// Past deadlines fire on the next tick.
+	w.schedule(5, 10);
+	fired.clear();
+	assert(w.advance(1, record) == 1 && fired.back() == 10);
+
+	// Callbacks can cancel timers due in the same tick, and schedule new
+	// ones, which fire no earlier than the next tick.
+	const auto t = w.now() + 1;
+	auto second = w.schedule(t, 2);
+	std::vector<wheel::handle> own(1);
+	own[0] = w.schedule(t, 1);
+	w.schedule(t, 3);
+	fired.clear();
+	auto cancelled = w.schedule(t, 0);
+	assert(w.cancel(cancelled));
+	w.cancel(second);
+	second = w.schedule(t, 4);
+	assert(w.advance(1, [&](int v) {
+		fired.push_back(v);
+		if (v == 1) {
+			assert(!w.cancel(own[0]));
+			assert(w.cancel(second));
+			w.schedule(t, 5);
+		}
+	}) == 2);
+	assert((fired == std::vector<int>{1, 3}));
+	assert(w.size() == 1);
+	assert(w.advance(1, record) == 1 && fired.back() == 5);
+
+	// A throwing callback leaves the rest of its batch for the next call.
+	for (int i = 0; i < 3; ++i) {
+		w.schedule(w.now() + 1, i);
+	}
+	fired.clear();
+	try {
+		w.advance(1, [&](int v) {
+			if (v == 1) {
+				throw std::runtime_error("timer");
+			}
+			fired.push_back(v);
+		});
+		assert(false);
+	} catch (std::runtime_error&) {
+	}
+	assert(w.size() == 1);
+	assert(w.advance(0, record) == 1);
+	assert((fired == std::vector<int>{0, 2}));
+}
+
+#if __cplusplus >= 202002L
+local_executor::task consume(safe_channel<int>& ch, std::vector<int>& out)
+{
+	while (auto v = co_await ch.pop()) {
+		out.push_back(*v);
+	}
+}
+
+local_executor::task consume_batches(safe_channel<int>& ch, std::vector<std::size_t>& sizes, std::vector<int>& out)
+{
+	for (;;) {
+		auto batch = co_await ch.pop_many(3);
+		if (batch.empty()) {
+			co_return;
+		}
+
+		sizes.push_back(batch.size());
+		out.insert(out.end(), batch.begin(), batch.end());
+	}
+}
+
+local_executor::task produce(safe_channel<int>& ch, int first, int last)
+{
+	for (int i = first; i < last; ++i) {
+		if (!co_await ch.push(i)) {
+			co_return;
+		}
+	}
+}
+
+local_executor::task fail()
+{
+	co_await std::suspend_never();
+	throw std::runtime_error("Task failed");
+}
+
+void test_channel()
+{
+	local_executor ex;
+	std::vector<int> out;
+
+	{
+		// The first element is handed to the waiting task, the second
+		// queues up until it runs.
+		safe_channel<int> ch(ex);
+		ex.spawn(consume(ch, out));
+		assert(ex.run() == 1);
+		assert(ch.push_back(1) && ch.push_back(2) && ch.size() == 1);
+		ex.run();
+		assert((out == std::vector<int>{1, 2}));
+
+		ch.close();
+		assert(!ch.push_back(3));
+		assert(ex.run() == 1);
+	}
+
+	{
+		// Batches take what is queued; once woken, a task's batch keeps
+		// filling until it runs.
+		safe_channel<int> ch(ex);
+		for (int i = 0; i < 7; ++i) {
+			ch.push_back(i);
+		}
+
+		std::vector<std::size_t> sizes;
+		out.clear();
+		ex.spawn(consume_batches(ch, sizes, out));
+		ex.run();
+		for (int i = 7; i < 11; ++i) {
+			ch.push_back(i);
+		}
+		assert(ch.size() == 1);
+		ex.run();
+		ch.close();
+		ex.run();
+		assert((sizes == std::vector<std::size_t>{3, 3, 1, 3, 1}));
+		assert((out == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+	}
+
+	{
+		// Bounded: the producer waits for room.
+		safe_channel<int> ch(ex, 2);
+		ex.spawn(produce(ch, 0, 5));
+		ex.run();
+		assert(ch.size() == 2 && !ch.push_back(9));
+
+		out.clear();
+		ex.spawn(consume(ch, out));
+		ex.run();
+		assert((out == std::vector<int>{0, 1, 2, 3, 4}));
+		ch.close();
+		ex.run();
+	}
+
+	{
+		// A closed channel fails waiting producers.
+		safe_channel<int> ch(ex, 1);
+		ex.spawn(produce(ch, 0, 5));
+		ex.run();
+		ch.close();
+		ex.run();
+		assert(ch.size() == 1);
+	}
+
+	// Destroying the channel wakes the tasks waiting on it.
+	out.clear();
+	auto ch = std::make_unique<safe_channel<int>>(ex);
+	ex.spawn(consume(*ch, out));
+	ex.run();
+	ch.reset();
+	assert(ex.run() == 1);
+
+	// Destroying the executor destroys the tasks that wait, which leave the
+	// channel.
+	safe_channel<int> outlived(ex);
+	{
+		local_executor local;
+		safe_channel<int> ch(local);
+		local.spawn(consume(ch, out));
+		local.spawn(consume(outlived, out));
+		local.run();
+	}
+	assert(outlived.push_back(1) && outlived.size() == 1);
+
+	bool threw = false;
+	ex.spawn(fail());
+	try {
+		ex.run();
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	assert(threw);
 }
+#endif
 
-int main(int argc, char**)
+int main(int argc, char** argv)
 {
-	if (argc == 2) {
+	if (argc == 2 && std::strcmp(argv[1], "-a") == 0) {
+		test_allocations();
+		test_stale_iterator_memory();
+	} else if (argc == 2) {
 		test<std::list<int>>();
+		test_forward_list<std::forward_list<int>>();
+		test_packed<std::list<long long>>();
 	} else {
 		test<safelist<int>>();
+		test_forward_list<safe_forward_list<int>>();
+		test_packed<packed_safelist<long long>>();
+		test_packed_safelist();
+		test_lru_cache();
+		test_rcu_safelist();
+		test_sharded_safelist();
+		test_weak_observer_list();
+		test_timing_wheel();
+		test_node_handles();
+		test_normalize();
+		test_deferred_reclaim();
+		test_defragment();
+		test_throwing_compare();
+		test_content_hash();
+		test_intrusive_safelist();
+#if __cplusplus >= 202002L
+		test_channel();
+#endif
 	}
 
 	return 0;
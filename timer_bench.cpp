@@ -0,0 +1,107 @@
+#include "timing_wheel.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Schedules a stream of timeouts, most of which are cancelled again soon
+// after, the way request timeouts are; time moves one tick per RATE timers.
+// Reports timers per second, including firing the remaining ones, for a
+// timing_wheel and a binary heap that skips cancelled timers when they
+// come up.
+
+// Cancels a timer this many timers after scheduling it.
+const size_t lag = 1000;
+
+// Keeps the timers from being optimised away.
+volatile uint64_t sink;
+
+struct params
+{
+	size_t count;
+	unsigned cancel_percent;
+	size_t rate;
+	uint64_t max_delay;
+};
+
+template<class Schedule, class Cancel, class Advance>
+double run(const params& p, Schedule schedule, Cancel cancel, Advance advance)
+{
+	mt19937_64 r(42);
+	uniform_int_distribution<uint64_t> delay(1, p.max_delay);
+	uint64_t fired = 0;
+
+	const auto start = chrono::steady_clock::now();
+	for (size_t i = 0; i < p.count; ++i) {
+		if (i % p.rate == 0) {
+			fired += advance(1);
+		}
+		schedule(i, delay(r));
+		if (i >= lag && (i - lag) % 100 < p.cancel_percent) {
+			cancel(i - lag);
+		}
+	}
+	fired += advance(p.max_delay + 1);
+	sink = fired;
+
+	const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return p.count / elapsed.count();
+}
+
+double bench_wheel(const params& p)
+{
+	timing_wheel<uint64_t> w;
+	vector<timing_wheel<uint64_t>::handle> handles(p.count);
+	uint64_t sum = 0;
+
+	return run(p,
+		[&](size_t id, uint64_t delay) { handles[id] = w.schedule(w.now() + delay, id); },
+		[&](size_t id) { w.cancel(handles[id]); },
+		[&](uint64_t ticks) { return w.advance(ticks, [&](uint64_t id) { sum += id; }); });
+}
+
+double bench_heap(const params& p)
+{
+	typedef pair<uint64_t, size_t> timer;
+	priority_queue<timer, vector<timer>, greater<timer>> heap;
+	vector<bool> cancelled(p.count);
+	uint64_t now = 0, sum = 0;
+
+	return run(p,
+		[&](size_t id, uint64_t delay) { heap.emplace(now + delay, id); },
+		[&](size_t id) { cancelled[id] = true; },
+		[&](uint64_t ticks) {
+			now += ticks;
+			uint64_t fired = 0;
+			while (!heap.empty() && heap.top().first <= now) {
+				const auto id = heap.top().second;
+				heap.pop();
+				if (!cancelled[id]) {
+					sum += id;
+					++fired;
+				}
+			}
+			return fired;
+		});
+}
+
+int main(int argc, char** argv)
+{
+	params p;
+	p.count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4000000;
+	p.cancel_percent = argc > 2 ? atoi(argv[2]) : 90;
+	p.rate = argc > 3 ? strtoull(argv[3], nullptr, 10) : 10;
+	p.max_delay = argc > 4 ? strtoull(argv[4], nullptr, 10) : 100000;
+
+	cout << "timing_wheel: " << bench_wheel(p) << " timers/s" << endl;
+	cout << "binary heap: " << bench_heap(p) << " timers/s" << endl;
+
+	return 0;
+}
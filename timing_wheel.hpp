@@ -0,0 +1,291 @@
+#pragma once
+
+#include "safelist.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Hierarchical timing wheel, with a safelist for every slot.
+//
+// Level 0 has a slot for each of the next 256 ticks, level 1 for each of
+// the next 256 runs of 256 ticks, and so on; timers further out than the
+// top level reaches wait on an overflow list. A timer goes into the lowest
+// level that reaches its deadline. Once time gets to a slot of a higher
+// level, that slot is cascaded: its timers are spread over the lower
+// levels, each with a single-node splice. Level 0 slots are expired as a
+// whole, by splicing them onto the list of timers to fire.
+//
+// Scheduling and cancelling take constant time. Handles refer to their
+// timer weakly, so cancelling a timer that already fired, or was
+// cancelled, does nothing. Ticks in which nothing can happen are skipped.
+template<class T>
+class timing_wheel
+{
+	private:
+		struct timer;
+
+	public:
+		typedef T value_type;
+		typedef std::uint64_t tick_type;
+		typedef std::size_t size_type;
+
+		class handle;
+
+		explicit timing_wheel(tick_type now = 0);
+
+		// Schedules value to fire at the given tick. Deadlines that have
+		// passed fire on the next tick.
+		handle schedule(tick_type deadline, value_type value);
+
+		// Returns whether the timer was still pending. Timers can be
+		// cancelled from callbacks, including ones that are due in the same
+		// tick.
+		bool cancel(const handle& h);
+
+		// Moves time forward, and calls f with the value of every timer
+		// that falls due, in order of deadline. Returns the number of timers
+		// fired. If f throws, the timers that are due but have not fired
+		// yet fire on the next call.
+		template<class F>
+		size_type advance(tick_type ticks, F f);
+
+		tick_type now() const { return m_now; };
+
+		// Pending timers, including those due but not fired yet.
+		size_type size() const { return m_size; };
+		bool empty() const { return m_size == 0; };
+
+	private:
+		static const unsigned slot_bits = 8;
+		static const unsigned slots = 1 << slot_bits;
+		static const unsigned levels = 4;
+
+		// Bucket indices: level * slots + slot, then these.
+		static const unsigned overflow = levels * slots;
+		static const unsigned firing = overflow + 1;
+		static const unsigned none = firing + 1;
+
+		struct timer
+		{
+			tick_type deadline;
+			unsigned bucket;
+			value_type value;
+
+			timer(tick_type deadline, value_type&& value): deadline(deadline), bucket(none), value(std::move(value)) {};
+		};
+
+		typedef safelist<timer> bucket_list;
+
+		tick_type m_now;
+		size_type m_size;
+		bucket_list m_buckets[firing + 1];
+		// Timers on each level, the overflow list included.
+		size_type m_counts[levels + 1];
+
+		unsigned bucket_of(tick_type deadline) const;
+		void cascade(unsigned bucket);
+		void tick();
+
+		template<class F>
+		size_type fire(F& f);
+};
+
+// Refers to a scheduled timer. Default constructed handles refer to none.
+template<class T>
+class timing_wheel<T>::handle
+{
+	public:
+		friend timing_wheel<T>;
+
+		handle() = default;
+
+	private:
+		typename bucket_list::iterator item;
+
+		explicit handle(typename bucket_list::iterator item): item(item) {};
+};
+
+template<class T>
+const unsigned timing_wheel<T>::slot_bits;
+template<class T>
+const unsigned timing_wheel<T>::slots;
+template<class T>
+const unsigned timing_wheel<T>::levels;
+template<class T>
+const unsigned timing_wheel<T>::overflow;
+template<class T>
+const unsigned timing_wheel<T>::firing;
+template<class T>
+const unsigned timing_wheel<T>::none;
+
+template<class T>
+timing_wheel<T>::timing_wheel(tick_type now): m_now(now), m_size(0), m_counts()
+{
+}
+
+template<class T>
+typename timing_wheel<T>::handle timing_wheel<T>::schedule(tick_type deadline, value_type value)
+{
+	if (deadline <= m_now) {
+		deadline = m_now + 1;
+	}
+
+	const auto b = bucket_of(deadline);
+	auto& bucket = m_buckets[b];
+	bucket.emplace_back(deadline, std::move(value));
+	auto it = --bucket.end();
+	it->bucket = b;
+
+	++m_counts[b / slots];
+	++m_size;
+
+	return handle(it);
+}
+
+template<class T>
+bool timing_wheel<T>::cancel(const handle& h)
+{
+	if (h.item == typename bucket_list::iterator()) {
+		return false;
+	}
+
+	auto& tm = *h.item;
+	auto b = tm.bucket;
+	if (b == none) {
+		return false;
+	}
+	// Level 0 timers that are due have been moved to the firing list as a
+	// whole, and still name the slot they came from.
+	if (b < slots && tm.deadline <= m_now) {
+		b = firing;
+	}
+
+	tm.bucket = none;
+	m_buckets[b].erase(h.item);
+
+	if (b != firing) {
+		--m_counts[b / slots];
+	}
+	--m_size;
+
+	return true;
+}
+
+template<class T>
+template<class F>
+typename timing_wheel<T>::size_type timing_wheel<T>::advance(tick_type ticks, F f)
+{
+	auto fired = fire(f);
+
+	while (ticks > 0) {
+		// Nothing happens until the next cascade of the lowest level that
+		// has timers, so the ticks before it can be skipped.
+		unsigned level = 0;
+		while (level <= levels && m_counts[level] == 0) {
+			++level;
+		}
+
+		tick_type step = ticks;
+		if (level == 0) {
+			step = 1;
+		} else if (level <= levels) {
+			const tick_type period = tick_type(1) << (level * slot_bits);
+			const tick_type next = (m_now / period + 1) * period;
+			if (next - m_now < step) {
+				step = next - m_now;
+			}
+		}
+
+		m_now += step - 1;
+		ticks -= step;
+		tick();
+		fired += fire(f);
+	}
+
+	return fired;
+}
+
+// The lowest level whose span from the next tick reaches the deadline, and
+// the slot there that is cascaded, or expired, in the deadline's run of
+// ticks.
+template<class T>
+unsigned timing_wheel<T>::bucket_of(tick_type deadline) const
+{
+	const auto delta = deadline - (m_now + 1);
+	for (unsigned level = 0; level < levels; ++level) {
+		if (delta >> ((level + 1) * slot_bits) == 0) {
+			return level * slots + ((deadline >> (level * slot_bits)) & (slots - 1));
+		}
+	}
+
+	return overflow;
+}
+
+// Overflow timers may stay where they are, so the slot is emptied first.
+template<class T>
+void timing_wheel<T>::cascade(unsigned bucket)
+{
+	bucket_list from;
+	from.splice(from.end(), m_buckets[bucket]);
+	m_counts[bucket / slots] -= from.size();
+
+	while (!from.empty()) {
+		auto it = from.begin();
+		const auto to = bucket_of(it->deadline);
+		it->bucket = to;
+		m_buckets[to].splice(m_buckets[to].end(), from, it);
+		++m_counts[to / slots];
+	}
+}
+
+// Processes the tick after m_now: cascades the slots that time has reached,
+// then moves the due level 0 slot onto the firing list.
+template<class T>
+void timing_wheel<T>::tick()
+{
+	const auto t = m_now + 1;
+
+	if ((t & (slots - 1)) == 0) {
+		unsigned level = 1;
+		for (; level < levels; ++level) {
+			const unsigned slot = (t >> (level * slot_bits)) & (slots - 1);
+			cascade(level * slots + slot);
+			if (slot != 0) {
+				break;
+			}
+		}
+		if (level == levels) {
+			cascade(overflow);
+		}
+	}
+
+	m_now = t;
+
+	auto& due = m_buckets[t & (slots - 1)];
+	if (due.empty()) {
+		return;
+	}
+
+	m_counts[0] -= due.size();
+	m_buckets[firing].splice(m_buckets[firing].end(), due);
+}
+
+// A timer is taken off the firing list before its callback runs, so that
+// cancelling it from there does nothing.
+template<class T>
+template<class F>
+typename timing_wheel<T>::size_type timing_wheel<T>::fire(F& f)
+{
+	auto& due = m_buckets[firing];
+	size_type fired = 0;
+	while (!due.empty()) {
+		auto node = due.extract(due.begin());
+		node.value().bucket = none;
+		--m_size;
+		++fired;
+		f(node.value().value);
+	}
+
+	return fired;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "safelist.hpp"
+
+#include <cstddef>
+#include <memory>
+
+// List of observers held by weak references, for notifying whoever is
+// still alive.
+//
+// Observers that have expired, or were removed, are skipped by notify()
+// and only counted. Once enough of them have piled up they are pruned in
+// one pass, so a notification costs no erase per dead observer. The
+// observers are kept in a safelist, so they can be added and removed while
+// a notification is running, also by the observers themselves. Observers
+// added during a notification are notified by it as well.
+template<class T>
+class weak_observer_list
+{
+	public:
+		typedef T observer_type;
+		typedef std::size_t size_type;
+
+		// Identifies an added observer, to remove it again.
+		typedef typename safelist<std::weak_ptr<T>>::iterator handle;
+
+		// Pruning waits for at least min_batch dead observers, and for a
+		// quarter of the list to be dead.
+		explicit weak_observer_list(size_type min_batch = 64): m_min_batch(min_batch), m_dead(0), m_depth(0), m_compact_due(false) {};
+
+		handle add(const std::shared_ptr<T>& observer);
+
+		// Both only mark the observer dead, so they take effect right away
+		// but leave the pruning to later. Removing an observer twice does
+		// nothing.
+		void remove(handle h);
+		void remove(const std::shared_ptr<T>& observer);
+
+		// Calls f with every live observer, in the order they were added,
+		// and returns how many there were. Prunes the list afterwards if
+		// enough dead observers were seen.
+		template<class F>
+		size_type notify(F f);
+
+		// Prunes the dead observers now. During a notification, the
+		// outermost notify() does it once it is done, as the entry a pass
+		// is on must stay in the list.
+		void compact();
+
+		// Observers in the list, including the dead ones not pruned yet.
+		size_type size() const { return observers.size(); };
+		bool empty() const { return observers.empty(); };
+
+		// Dead observers seen since the last pruning.
+		size_type dead() const { return m_dead; };
+
+	private:
+		safelist<std::weak_ptr<T>> observers;
+		size_type m_min_batch;
+		size_type m_dead;
+		// Number of notify() calls running, as observers may notify again.
+		unsigned m_depth;
+		// Set by compact() during a notification.
+		bool m_compact_due;
+
+		void prune();
+};
+
+template<class T>
+typename weak_observer_list<T>::handle weak_observer_list<T>::add(const std::shared_ptr<T>& observer)
+{
+	return observers.insert(observers.end(), observer);
+}
+
+// A handle whose entry has been pruned and freed compares equal to a
+// default one. One that was pruned during a notification may still be
+// alive, but clearing it is harmless.
+template<class T>
+void weak_observer_list<T>::remove(handle h)
+{
+	if (h != handle() && !h->expired()) {
+		h->reset();
+		++m_dead;
+	}
+}
+
+template<class T>
+void weak_observer_list<T>::remove(const std::shared_ptr<T>& observer)
+{
+	for (auto& w : observers) {
+		if (!w.owner_before(observer) && !observer.owner_before(w) && !w.expired()) {
+			w.reset();
+			++m_dead;
+		}
+	}
+}
+
+template<class T>
+template<class F>
+typename weak_observer_list<T>::size_type weak_observer_list<T>::notify(F f)
+{
+	size_type notified = 0, dead = 0;
+
+	++m_depth;
+	try {
+		for (auto it = observers.begin(), end = observers.end(); it != end; ++it) {
+			if (auto observer = it->lock()) {
+				f(*observer);
+				++notified;
+			} else {
+				++dead;
+			}
+		}
+	} catch (...) {
+		--m_depth;
+		throw;
+	}
+	--m_depth;
+
+	// Removals during the pass may have been counted already, so take the
+	// larger count rather than the sum.
+	if (dead > m_dead) {
+		m_dead = dead;
+	}
+	if (m_depth == 0 && (m_compact_due || (m_dead >= m_min_batch && m_dead * 4 >= observers.size()))) {
+		prune();
+	}
+
+	return notified;
+}
+
+template<class T>
+void weak_observer_list<T>::compact()
+{
+	if (m_depth > 0) {
+		m_compact_due = true;
+	} else {
+		prune();
+	}
+}
+
+template<class T>
+void weak_observer_list<T>::prune()
+{
+	observers.remove_if([](const std::weak_ptr<T>& w) { return w.expired(); });
+	m_dead = 0;
+	m_compact_due = false;
+}